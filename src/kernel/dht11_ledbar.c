@@ -13,6 +13,10 @@
 #include <linux/mutex.h>
 #include <linux/string.h>
 #include <linux/ioctl.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/ktime.h>
+#include <linux/sysfs.h>
 
 #define DRIVER_NAME "dht11"
 #define CLASS_NAME  "dht11_class"
@@ -44,6 +48,20 @@ static DEFINE_MUTEX(dht_lock);
 static struct dht11_data g_cache;
 static unsigned long g_last_sample_j;
 
+/* 샘플 세대: 샘플 끝날 때마다 +1, poll()은 파일별로 마지막 본 세대와 비교 */
+static unsigned long g_seq;
+static DECLARE_WAIT_QUEUE_HEAD(dht_wq);
+
+/* ===== stats (/sys/class/dht11_class/dht11/stats/), dht_lock으로 보호 ===== */
+static struct {
+	u64 reads_ok;
+	u64 checksum_errors;
+	u64 timeouts;          /* 센서 응답/비트 타이밍 없음 */
+	u64 other_errors;      /* GPIO 방향 전환 실패 등 */
+	u64 read_ns_total;     /* start 신호 ~ 40bit 끝 (1.1s 간격 대기 제외) */
+	u64 read_ns_max;
+} g_stats;
+
 /* ===== autopoll ===== */
 static int autopoll = 1;          /* 1=enabled */
 module_param(autopoll, int, 0644);
@@ -78,10 +96,11 @@ static int wait_pin_status(int level, int time_us)
 	return counter;
 }
 
-static int dht11_sample(u8 *out_temp, u8 *out_humi)
+static int dht11_sample(u8 *out_temp, u8 *out_humi, u64 *xfer_ns)
 {
 	u8 data[5] = {0,};
 	unsigned long flags;
+	u64 t0;
 	int i, bit;
 	int ret;
 
@@ -92,6 +111,7 @@ static int dht11_sample(u8 *out_temp, u8 *out_humi)
 	}
 
 	/* start signal */
+	t0 = ktime_get_ns();
 	ret = gpio_direction_output(dht_gpio, 0);
 	if (ret) return ret;
 
@@ -136,6 +156,7 @@ static int dht11_sample(u8 *out_temp, u8 *out_humi)
 
 out_irq:
 	local_irq_restore(flags);
+	*xfer_ns = ktime_get_ns() - t0;
 	if (ret < 0)
 		return ret;
 
@@ -153,10 +174,24 @@ out_irq:
 static void poll_work_fn(struct work_struct *work)
 {
 	u8 t = 0, h = 0;
+	u64 ns = 0;
 	int ret;
 
 	mutex_lock(&dht_lock);
-	ret = dht11_sample(&t, &h);
+	ret = dht11_sample(&t, &h, &ns);
+	if (ret == -ETIMEDOUT)
+		g_stats.timeouts++;
+	else if (ret == -EIO)
+		g_stats.checksum_errors++;
+	else if (ret < 0)
+		g_stats.other_errors++;
+	else
+		g_stats.reads_ok++;
+	if (ns) {
+		g_stats.read_ns_total += ns;
+		if (ns > g_stats.read_ns_max)
+			g_stats.read_ns_max = ns;
+	}
 	if (ret == 0) {
 		g_cache.temp = t;
 		g_cache.humi = h;
@@ -165,12 +200,35 @@ static void poll_work_fn(struct work_struct *work)
 	} else {
 		g_cache.ok = 0;
 	}
+	g_seq++;
 	mutex_unlock(&dht_lock);
 
+	wake_up_interruptible(&dht_wq);
+
 	if (autopoll)
 		schedule_delayed_work(&poll_work, msecs_to_jiffies(poll_ms));
 }
 
+/* open: 지금 세대를 본 것으로 시작 (첫 poll은 다음 샘플에서 깨어남) */
+static int dht_open(struct inode *inode, struct file *filp)
+{
+	mutex_lock(&dht_lock);
+	filp->private_data = (void *)g_seq;
+	mutex_unlock(&dht_lock);
+	return 0;
+}
+
+static __poll_t dht_poll(struct file *filp, poll_table *wait)
+{
+	__poll_t mask = 0;
+
+	poll_wait(filp, &dht_wq, wait);
+
+	if (READ_ONCE(g_seq) != (unsigned long)filp->private_data)
+		mask |= POLLIN | POLLRDNORM;
+	return mask;
+}
+
 /* read: "T=23C H=45%\n" */
 static ssize_t dht_read(struct file *filp, char __user *buf, size_t len, loff_t *off)
 {
@@ -183,6 +241,7 @@ static ssize_t dht_read(struct file *filp, char __user *buf, size_t len, loff_t
 
 	mutex_lock(&dht_lock);
 	d = g_cache;
+	filp->private_data = (void *)g_seq;
 	mutex_unlock(&dht_lock);
 
 	if (d.ok)
@@ -209,6 +268,7 @@ static long dht_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 
 	mutex_lock(&dht_lock);
 	d = g_cache;
+	filp->private_data = (void *)g_seq;
 	mutex_unlock(&dht_lock);
 
 	if (copy_to_user((void __user *)arg, &d, sizeof(d)))
@@ -219,10 +279,49 @@ static long dht_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 
 static const struct file_operations fops = {
 	.owner          = THIS_MODULE,
+	.open           = dht_open,
 	.read           = dht_read,
+	.poll           = dht_poll,
 	.unlocked_ioctl = dht_ioctl,
 };
 
+/* 파일 하나에 값 하나 */
+#define DHT_STAT_ATTR(field)							\
+static ssize_t field##_show(struct device *dev, struct device_attribute *attr, char *buf)	\
+{										\
+	u64 v;									\
+	mutex_lock(&dht_lock);							\
+	v = g_stats.field;							\
+	mutex_unlock(&dht_lock);						\
+	return sysfs_emit(buf, "%llu\n", v);					\
+}										\
+static DEVICE_ATTR_RO(field)
+
+DHT_STAT_ATTR(reads_ok);
+DHT_STAT_ATTR(checksum_errors);
+DHT_STAT_ATTR(timeouts);
+DHT_STAT_ATTR(other_errors);
+DHT_STAT_ATTR(read_ns_total);
+DHT_STAT_ATTR(read_ns_max);
+
+static struct attribute *dht_stats_attrs[] = {
+	&dev_attr_reads_ok.attr,
+	&dev_attr_checksum_errors.attr,
+	&dev_attr_timeouts.attr,
+	&dev_attr_other_errors.attr,
+	&dev_attr_read_ns_total.attr,
+	&dev_attr_read_ns_max.attr,
+	NULL,
+};
+static const struct attribute_group dht_stats_group = {
+	.name  = "stats",
+	.attrs = dht_stats_attrs,
+};
+static const struct attribute_group *dht_groups[] = {
+	&dht_stats_group,
+	NULL,
+};
+
 static int request_led_gpios(void)
 {
 	int i, ret;
@@ -293,7 +392,8 @@ static int __init dht_init(void)
 		goto err_cdev;
 	}
 
-	if (!device_create(dht_class, NULL, device_number, NULL, DRIVER_NAME)) {
+	if (IS_ERR_OR_NULL(device_create_with_groups(dht_class, NULL, device_number, NULL,
+	                                             dht_groups, DRIVER_NAME))) {
 		ret = -ENOMEM;
 		goto err_class;
 	}
@@ -3,12 +3,21 @@
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/gpio.h>
+#include <linux/gpio/consumer.h>
 #include <linux/delay.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
 #include <linux/bcd.h>
 #include <linux/platform_device.h>
 #include <linux/device.h>
+#include <linux/spinlock.h>
+#include <linux/atomic.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+#include <linux/nvmem-provider.h>
+#include <linux/of.h>
+#include <linux/mod_devicetable.h>
 
 #define DRV_NAME "ds1302_rpi"
 
@@ -22,109 +31,249 @@
 #define DS1302_REG_YEAR      0x8C
 #define DS1302_REG_WP        0x8E
 
-// ====== module params (BCM GPIO 번호) ======
+// clock burst: sec,min,hour,date,month,day,year,WP 를 CE 한 번에 연속 전송
+// (read 시작 시점에 시간 레지스터가 버퍼로 래치되므로 롤오버 중에도 찢어지지 않음)
+#define DS1302_CMD_CLOCK_BURST 0xBE
+#define DS1302_CLOCK_BURST_LEN 8
+
+// 배터리 백업 RAM 31바이트. RAM burst는 RAM0부터 시작, 중간에 끊어도 됨
+#define DS1302_CMD_RAM_BURST   0xFE
+#define DS1302_RAM_SIZE        31
+
+// ====== 배선 ======
+// DT로 붙이는 경우:
+//   rtc-ds1302 {
+//       compatible = "rpi,ds1302-gpio";
+//       clk-gpios = <&gpio 5 GPIO_ACTIVE_HIGH>;
+//       io-gpios  = <&gpio 6 GPIO_ACTIVE_HIGH>;
+//       ce-gpios  = <&gpio 13 GPIO_ACTIVE_HIGH>;
+//   };
+// DT 노드가 없으면 아래 BCM 번호로 platform_device 하나를 직접 만든다(legacy_device=1).
 static int gpio_clk = 5;
 static int gpio_io  = 6;
 static int gpio_ce  = 13;
+static int legacy_device = 1;
 
 module_param(gpio_clk, int, 0444);
 module_param(gpio_io,  int, 0444);
 module_param(gpio_ce,  int, 0444);
+module_param(legacy_device, int, 0444);
 
-MODULE_PARM_DESC(gpio_clk, "DS1302 CLK GPIO (BCM)");
-MODULE_PARM_DESC(gpio_io,  "DS1302 IO/DAT GPIO (BCM)");
-MODULE_PARM_DESC(gpio_ce,  "DS1302 CE/RST GPIO (BCM)");
+MODULE_PARM_DESC(gpio_clk, "DS1302 CLK GPIO (BCM), non-DT instance only");
+MODULE_PARM_DESC(gpio_io,  "DS1302 IO/DAT GPIO (BCM), non-DT instance only");
+MODULE_PARM_DESC(gpio_ce,  "DS1302 CE/RST GPIO (BCM), non-DT instance only");
+MODULE_PARM_DESC(legacy_device, "Create a non-DT instance from gpio_* when no DT node exists");
 
-struct ds1302_priv {
-	struct rtc_device *rtc;
-	struct mutex lock;
+// non-DT 인스턴스용 platform data (BCM 번호)
+struct ds1302_pdata {
+	int clk, io, ce;
 };
 
-static struct ds1302_priv *g_priv;
+// ====== bit-bang 타이밍 ======
+static int vcc_mv = 3300;
+module_param(vcc_mv, int, 0444);
+MODULE_PARM_DESC(vcc_mv, "DS1302 supply voltage in mV, selects datasheet timings (2000..5000)");
+
+// ====== 시간 캐시 ======
+static int cache_resync_ms = 60000;
+module_param(cache_resync_ms, int, 0644);
+MODULE_PARM_DESC(cache_resync_ms, "Re-read the chip after this many ms of cached reads (0 = no cache)");
+
+static int phase_step_us = 2000;
+module_param(phase_step_us, int, 0644);
+MODULE_PARM_DESC(phase_step_us, "Poll step used to find the chip's seconds rollover (alarm/UIE alignment)");
+
+// ====== NVRAM ======
+static int nvram_writeback_ms = 1000;
+module_param(nvram_writeback_ms, int, 0644);
+MODULE_PARM_DESC(nvram_writeback_ms, "Delay before dirty NVRAM bytes are burst-written (0 = write-through)");
+
+// 데이터시트 AC 특성(ns). 2.0V/5.0V 두 열만 있어서 vcc_mv로 선형 보간해서 씀
+struct ds1302_timing {
+	u32 tdc;    // data -> CLK setup
+	u32 tcdh;   // CLK -> data hold
+	u32 tcdd;   // CLK -> data delay (read)
+	u32 tcl;    // CLK low
+	u32 tch;    // CLK high
+	u32 tcc;    // CE -> CLK setup
+	u32 tcch;   // CLK -> CE hold
+	u32 tcwh;   // CE inactive
+};
 
-static inline void ds_delay(void) { udelay(1); }
+static const struct ds1302_timing ds1302_timing_2v0 = {
+	.tdc = 200, .tcdh = 280, .tcdd = 800, .tcl = 1000, .tch = 1000,
+	.tcc = 4000, .tcch = 240, .tcwh = 4000,
+};
 
-static inline void clk_write(int v) { gpio_set_value(gpio_clk, v); }
-static inline void ce_write(int v)  { gpio_set_value(gpio_ce,  v); }
-static inline void io_write(int v)  { gpio_set_value(gpio_io,  v); }
-static inline int  io_read(void)    { return gpio_get_value(gpio_io); }
+static const struct ds1302_timing ds1302_timing_5v0 = {
+	.tdc = 50, .tcdh = 70, .tcdd = 200, .tcl = 250, .tch = 250,
+	.tcc = 1000, .tcch = 60, .tcwh = 1000,
+};
 
-static inline void io_dir_out(int v) { gpio_direction_output(gpio_io, v); }
-static inline void io_dir_in(void)   { gpio_direction_input(gpio_io); }
+struct ds1302_priv {
+	struct rtc_device *rtc;
+	struct mutex lock;   // GPIO 버스 + 아래 xfer 통계
+
+	struct gpio_desc *clk, *io, *ce;
+	struct ds1302_timing t;
+
+	// 트랜잭션(CE 한 사이클) 단위 통계
+	u64 xfer_count;
+	u64 xfer_ns_total;
+	u32 xfer_ns_last;
+	u32 xfer_ns_max;
+	u64 chip_reads;      // 시간 읽기로 칩을 실제로 읽은 수
+	u64 bad_reads;       // 그중 rtc_valid_tm 실패 (배선/전원 이상)
+	atomic64_t cache_hits;   // 칩 안 읽고 외삽으로 돌려준 수 (cache_lock 밖이라 atomic)
+
+	// 칩을 한 번 읽은 뒤에는 ktime_get() 경과분으로 외삽해서 돌려줌.
+	// anchor는 "cache_kt 시점에 칩이 cache_secs 로 막 넘어갔다"는 뜻.
+	// phase_locked=false 면 읽기로 잡은 anchor라 초 내부 위상을 모름(최대 1초 미만 늦음)
+	// -> phase_work가 초 경계를 찾아서 다시 잡는다.
+	spinlock_t cache_lock;
+	bool cache_valid;
+	bool phase_locked;
+	time64_t cache_secs;
+	ktime_t cache_kt;
+	ktime_t cache_sync_kt;     // 마지막으로 칩과 맞춰본 시각
+	struct delayed_work phase_work;
+
+	// 알람/UIE 에뮬레이션: anchor 기준으로 계산한 만료 시각에 hrtimer
+	struct hrtimer alarm_timer;
+	time64_t alarm_secs;
+	bool alarm_enabled;
+	bool alarm_fired;
+
+	// NVRAM write-back 캐시: 처음 접근 때 RAM burst로 31바이트 통째로 읽어두고,
+	// 쓰기는 여기만 고친 뒤 [0, ram_dirty_end) 를 burst 한 번으로 내려씀
+	struct nvmem_device *nvmem;
+	u8 ram[DS1302_RAM_SIZE];
+	bool ram_valid;
+	int ram_dirty_end;
+	struct delayed_work ram_work;
+};
+
+static u32 ds1302_interp(u32 t2v0, u32 t5v0, int mv)
+{
+	mv = clamp(mv, 2000, 5000);
+	return t2v0 - (t2v0 - t5v0) * (u32)(mv - 2000) / 3000;
+}
 
-static inline void ds1302_clock_pulse(void)
+static void ds1302_timing_init(struct ds1302_priv *p, int mv)
 {
-	clk_write(1); ds_delay();
-	clk_write(0); ds_delay();
+	const struct ds1302_timing *a = &ds1302_timing_2v0, *b = &ds1302_timing_5v0;
+
+	p->t.tdc  = ds1302_interp(a->tdc,  b->tdc,  mv);
+	p->t.tcdh = ds1302_interp(a->tcdh, b->tcdh, mv);
+	p->t.tcdd = ds1302_interp(a->tcdd, b->tcdd, mv);
+	p->t.tcl  = ds1302_interp(a->tcl,  b->tcl,  mv);
+	p->t.tch  = ds1302_interp(a->tch,  b->tch,  mv);
+	p->t.tcc  = ds1302_interp(a->tcc,  b->tcc,  mv);
+	p->t.tcch = ds1302_interp(a->tcch, b->tcch, mv);
+	p->t.tcwh = ds1302_interp(a->tcwh, b->tcwh, mv);
+
+	// 읽기는 CLK high에서 샘플 -> 앞 falling 이후 tCDD가 지나 있어야 함
+	p->t.tcl = max(p->t.tcl, p->t.tcdd);
+	// hold는 CLK high 구간에 포함
+	p->t.tch = max(p->t.tch, p->t.tcdh);
 }
 
-// LSB first TX
-static void ds1302_tx_u8(u8 v)
+// LSB first TX (IO는 이미 output)
+static void ds1302_shift_out(struct ds1302_priv *p, u8 v)
 {
 	int i;
-	io_dir_out(0);
+
 	for (i = 0; i < 8; i++) {
-		io_write((v >> i) & 1);
-		ds_delay();
-		ds1302_clock_pulse();
+		gpiod_set_value(p->io, (v >> i) & 1);
+		ndelay(p->t.tdc);
+		gpiod_set_value(p->clk, 1);
+		ndelay(p->t.tch);
+		gpiod_set_value(p->clk, 0);
+		ndelay(p->t.tcl);
 	}
 }
 
-// LSB first RX  ✅ FIXED: 8 clocks, sample on CLK=1
-static u8 ds1302_rx_u8(void)
+// LSB first RX (IO는 이미 input)  ✅ 8 clocks, sample on CLK=1
+static u8 ds1302_shift_in(struct ds1302_priv *p)
 {
 	int i;
 	u8 temp = 0;
 
-	io_dir_in();
-	ds_delay();
-
 	for (i = 0; i < 8; i++) {
-		clk_write(1);
-		ds_delay();
-		if (io_read())
+		gpiod_set_value(p->clk, 1);
+		ndelay(p->t.tch);
+		if (gpiod_get_value(p->io))
 			temp |= (1u << i);
-		clk_write(0);
-		ds_delay();
+		gpiod_set_value(p->clk, 0);
+		ndelay(p->t.tcl);
 	}
 	return temp;
 }
 
-static inline void ds1302_begin(void)
+// CE 한 사이클 = 트랜잭션 1개: cmd 뒤에 n바이트 쓰기(tx) 또는 읽기(rx).
+// IO 방향은 트랜잭션 시작에 output, 읽기면 cmd 다음에 딱 한 번 input으로 바꿈.
+// p->lock 잡은 상태에서 호출.
+static void ds1302_xfer(struct ds1302_priv *p, u8 cmd, const u8 *tx, u8 *rx, int n)
 {
-	clk_write(0);
-	ce_write(1);
-	udelay(4);
-}
+	ktime_t t0 = ktime_get();
+	u32 ns;
+	int i;
 
-static inline void ds1302_end(void)
-{
-	udelay(1);
-	ce_write(0);
-	udelay(4);
+	gpiod_set_value(p->clk, 0);
+	gpiod_direction_output(p->io, 0);
+	gpiod_set_value(p->ce, 1);
+	ndelay(p->t.tcc);
+
+	ds1302_shift_out(p, cmd);
+
+	if (rx) {
+		gpiod_direction_input(p->io);
+		for (i = 0; i < n; i++)
+			rx[i] = ds1302_shift_in(p);
+	} else {
+		for (i = 0; i < n; i++)
+			ds1302_shift_out(p, tx[i]);
+	}
+
+	ndelay(p->t.tcch);
+	gpiod_set_value(p->ce, 0);
+	ndelay(p->t.tcwh);
+
+	ns = (u32)ktime_to_ns(ktime_sub(ktime_get(), t0));
+	p->xfer_ns_last = ns;
+	p->xfer_ns_total += ns;
+	p->xfer_count++;
+	if (ns > p->xfer_ns_max)
+		p->xfer_ns_max = ns;
 }
 
-static void ds1302_write_reg_raw(u8 reg_even, u8 raw_bcd)
+static void ds1302_write_reg_raw(struct ds1302_priv *p, u8 reg_even, u8 raw_bcd)
 {
-	ds1302_begin();
-	ds1302_tx_u8(reg_even & 0xFE); // write
-	ds1302_tx_u8(raw_bcd);
-	ds1302_end();
+	ds1302_xfer(p, reg_even & 0xFE, &raw_bcd, NULL, 1); // write
 }
 
-static u8 ds1302_read_reg_raw(u8 reg_even)
+static u8 ds1302_read_reg_raw(struct ds1302_priv *p, u8 reg_even)
 {
 	u8 v;
-	ds1302_begin();
-	ds1302_tx_u8((reg_even & 0xFE) | 0x01); // read = addr|1
-	v = ds1302_rx_u8();
-	ds1302_end();
+	ds1302_xfer(p, (reg_even & 0xFE) | 0x01, NULL, &v, 1); // read = addr|1
 	return v;
 }
 
-static void ds1302_write_protect(bool enable)
+// burst read: cmd 1바이트 후 n바이트 연속 수신 (n < 전체 길이면 중간에 끊어도 됨)
+static void ds1302_read_burst(struct ds1302_priv *p, u8 cmd_even, u8 *buf, int n)
+{
+	ds1302_xfer(p, (cmd_even & 0xFE) | 0x01, NULL, buf, n);
+}
+
+// burst write: clock burst는 8바이트(WP 포함)를 전부 써야 반영됨
+static void ds1302_write_burst(struct ds1302_priv *p, u8 cmd_even, const u8 *buf, int n)
 {
-	ds1302_write_reg_raw(DS1302_REG_WP, enable ? 0x80 : 0x00);
+	ds1302_xfer(p, cmd_even & 0xFE, buf, NULL, n);
+}
+
+static void ds1302_write_protect(struct ds1302_priv *p, bool enable)
+{
+	ds1302_write_reg_raw(p, DS1302_REG_WP, enable ? 0x80 : 0x00);
 }
 
 // CH bit(Seconds[7])가 1이면 오실레이터 stop 상태 -> 내려서 동작시키기
@@ -133,61 +282,120 @@ static void ds1302_ensure_osc_running(struct ds1302_priv *p)
 	u8 sec;
 
 	mutex_lock(&p->lock);
-	ds1302_write_protect(false);
+	ds1302_write_protect(p, false);
 
-	sec = ds1302_read_reg_raw(DS1302_REG_SECONDS);
+	sec = ds1302_read_reg_raw(p, DS1302_REG_SECONDS);
 	if (sec & 0x80) { // CH set => stopped
-		ds1302_write_reg_raw(DS1302_REG_SECONDS, sec & 0x7F); // CH=0
+		ds1302_write_reg_raw(p, DS1302_REG_SECONDS, sec & 0x7F); // CH=0
 	}
 
-	ds1302_write_protect(true);
+	ds1302_write_protect(p, true);
 	mutex_unlock(&p->lock);
 }
 
-// ✅ 안전하게 drvdata 찾기(널이면 ENODEV로 반환)
+// rtc core는 ops를 rtc->dev.parent(= platform device)로 부름 -> 인스턴스별 drvdata
 static inline struct ds1302_priv *ds_priv_from_dev(struct device *dev)
 {
-	struct ds1302_priv *p = NULL;
+	return dev ? dev_get_drvdata(dev) : NULL;
+}
 
-	if (dev)
-		p = dev_get_drvdata(dev);
-	if (!p && dev && dev->parent)
-		p = dev_get_drvdata(dev->parent);
-	if (!p)
-		p = g_priv; // fallback
+static void ds1302_alarm_arm(struct ds1302_priv *p);
+
+// anchor 교체. anchor가 바뀌면 알람 만료 시각도 다시 계산
+static void ds1302_cache_set(struct ds1302_priv *p, time64_t secs, ktime_t kt, bool phase_locked)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&p->cache_lock, flags);
+	p->cache_secs    = secs;
+	p->cache_kt      = kt;
+	p->cache_sync_kt = kt;
+	p->phase_locked  = phase_locked;
+	p->cache_valid   = true;
+	spin_unlock_irqrestore(&p->cache_lock, flags);
 
-	return p;
+	ds1302_alarm_arm(p);
 }
 
-static int ds1302_rtc_read_time(struct device *dev, struct rtc_time *tm)
+// cache_lock 잡은 상태에서 호출
+static time64_t ds1302_cache_extrapolate(struct ds1302_priv *p, ktime_t now)
 {
-	struct ds1302_priv *p = ds_priv_from_dev(dev);
-	u8 raw_sec, sec, min, hour, mday, mon, wday, year;
+	return p->cache_secs + div_s64(ktime_to_ns(ktime_sub(now, p->cache_kt)), NSEC_PER_SEC);
+}
 
-	if (!p)
-		return -ENODEV;
+// resync 주기 안이면 외삽 값으로 채우고 true
+static bool ds1302_cache_get(struct ds1302_priv *p, struct rtc_time *tm)
+{
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	time64_t secs;
+	s64 age_ms;
+	bool hit = false;
+
+	spin_lock_irqsave(&p->cache_lock, flags);
+	age_ms = ktime_ms_delta(now, p->cache_sync_kt);
+	if (p->cache_valid && cache_resync_ms > 0 && age_ms >= 0 && age_ms < cache_resync_ms) {
+		secs = ds1302_cache_extrapolate(p, now);
+		hit = true;
+	}
+	spin_unlock_irqrestore(&p->cache_lock, flags);
+
+	if (hit)
+		rtc_time64_to_tm(secs, tm);
+	return hit;
+}
+
+// 칩에서 새로 읽은 값으로 캐시 검증. 위상 잡힌 anchor와 같은 초면 anchor 유지,
+// 어긋났으면 읽은 값으로 임시 anchor 잡고 위상 다시 찾기
+static void ds1302_cache_resync(struct ds1302_priv *p, time64_t secs, ktime_t kt)
+{
+	unsigned long flags;
+	bool keep;
+
+	spin_lock_irqsave(&p->cache_lock, flags);
+	keep = p->cache_valid && p->phase_locked && ds1302_cache_extrapolate(p, kt) == secs;
+	if (keep)
+		p->cache_sync_kt = kt;
+	spin_unlock_irqrestore(&p->cache_lock, flags);
+
+	if (keep)
+		return;
+
+	ds1302_cache_set(p, secs, kt, false);
+	schedule_delayed_work(&p->phase_work, 0);
+}
+
+// 칩에서 시간 읽기 (clock burst 1회). 유효한 시간이면 true, kt = 읽은 직후 ktime
+static bool ds1302_read_chip(struct ds1302_priv *p, struct rtc_time *tm, ktime_t *kt)
+{
+	u8 buf[DS1302_CLOCK_BURST_LEN];
+	u8 sec, min, hour, mday, mon, wday, year;
+	bool ok;
 
 	mutex_lock(&p->lock);
 
-	raw_sec = ds1302_read_reg_raw(DS1302_REG_SECONDS);
+	// 7개 레지스터를 한 트랜잭션으로 (WP 바이트는 필요 없어서 7에서 끊음)
+	ds1302_read_burst(p, DS1302_CMD_CLOCK_BURST, buf, 7);
+	*kt = ktime_get();
+	p->chip_reads++;
+
 	// CH가 켜져있으면(멈춤) 읽는 김에 바로 내려서 살려줌
-	if (raw_sec & 0x80) {
-		ds1302_write_protect(false);
-		ds1302_write_reg_raw(DS1302_REG_SECONDS, raw_sec & 0x7F);
-		ds1302_write_protect(true);
-		raw_sec &= 0x7F;
+	if (buf[0] & 0x80) {
+		ds1302_write_protect(p, false);
+		ds1302_write_reg_raw(p, DS1302_REG_SECONDS, buf[0] & 0x7F);
+		ds1302_write_protect(p, true);
 	}
-	sec  = raw_sec & 0x7F;
-
-	min  = ds1302_read_reg_raw(DS1302_REG_MINUTES);
-	hour = ds1302_read_reg_raw(DS1302_REG_HOURS);
-	mday = ds1302_read_reg_raw(DS1302_REG_DATE);
-	mon  = ds1302_read_reg_raw(DS1302_REG_MONTH);
-	wday = ds1302_read_reg_raw(DS1302_REG_DAY);
-	year = ds1302_read_reg_raw(DS1302_REG_YEAR);
 
 	mutex_unlock(&p->lock);
 
+	sec  = buf[0] & 0x7F;
+	min  = buf[1];
+	hour = buf[2];
+	mday = buf[3];
+	mon  = buf[4];
+	wday = buf[5];
+	year = buf[6];
+
 	tm->tm_sec  = bcd2bin(sec);
 	tm->tm_min  = bcd2bin(min);
 
@@ -207,6 +415,71 @@ static int ds1302_rtc_read_time(struct device *dev, struct rtc_time *tm)
 	tm->tm_wday = (bcd2bin(wday) + 6) % 7; // 1~7 -> 0~6
 	tm->tm_year = 100 + bcd2bin(year);     // 00~99 -> 2000~2099
 
+	ok = rtc_valid_tm(tm) == 0;
+	if (!ok) {
+		mutex_lock(&p->lock);
+		p->bad_reads++;
+		mutex_unlock(&p->lock);
+	}
+	return ok;
+}
+
+// 초 레지스터를 phase_step_us 간격으로 읽어서 바뀌는 순간(초 경계)을 찾고
+// 그 시점으로 anchor를 다시 잡는다. 버스 락은 매 읽기마다만 잡음.
+static void ds1302_phase_work_fn(struct work_struct *work)
+{
+	struct ds1302_priv *p = container_of(to_delayed_work(work), struct ds1302_priv, phase_work);
+	struct rtc_time tm;
+	ktime_t start, prev, kt;
+	u8 sec0, sec;
+
+	mutex_lock(&p->lock);
+	sec0 = ds1302_read_reg_raw(p, DS1302_REG_SECONDS) & 0x7F;
+	start = prev = ktime_get();
+	mutex_unlock(&p->lock);
+
+	for (;;) {
+		usleep_range(phase_step_us, phase_step_us + 200);
+
+		mutex_lock(&p->lock);
+		sec = ds1302_read_reg_raw(p, DS1302_REG_SECONDS) & 0x7F;
+		kt = ktime_get();
+		mutex_unlock(&p->lock);
+
+		if (sec != sec0)
+			break;
+		if (ktime_ms_delta(kt, start) > 1500) {
+			dev_warn(p->rtc->dev.parent, "seconds register not ticking, phase lock skipped\n");
+			return;
+		}
+		prev = kt;
+	}
+
+	if (!ds1302_read_chip(p, &tm, &kt))
+		return;
+
+	// 경계는 (prev, kt] 안 -> 중간값을 anchor로
+	ds1302_cache_set(p, rtc_tm_to_time64(&tm),
+	                 ktime_add_ns(prev, ktime_to_ns(ktime_sub(kt, prev)) / 2), true);
+}
+
+static int ds1302_rtc_read_time(struct device *dev, struct rtc_time *tm)
+{
+	struct ds1302_priv *p = ds_priv_from_dev(dev);
+	ktime_t kt;
+
+	if (!p)
+		return -ENODEV;
+
+	// ✅ 캐시 hit이면 GPIO 버스 안 건드림
+	if (ds1302_cache_get(p, tm)) {
+		atomic64_inc(&p->cache_hits);
+		return 0;
+	}
+
+	if (ds1302_read_chip(p, tm, &kt))
+		ds1302_cache_resync(p, rtc_tm_to_time64(tm), kt);
+
 	return 0;
 }
 
@@ -215,7 +488,8 @@ static int ds1302_rtc_set_time(struct device *dev, struct rtc_time *tm)
 	struct ds1302_priv *p = ds_priv_from_dev(dev);
 
 	int s, mi, h, d, mon0, w0, y;
-	u8 sec_run, sec_halt, min, hour, mday, mon, wday, year;
+	u8 buf[DS1302_CLOCK_BURST_LEN];
+	struct rtc_time t = { 0 };
 
 	if (!p)
 		return -ENODEV;
@@ -243,143 +517,489 @@ static int ds1302_rtc_set_time(struct device *dev, struct rtc_time *tm)
 	if (y < 0) y = 0;
 	if (y > 99) y %= 100;
 
-	sec_run  = bin2bcd(s) & 0x7F;             // CH=0
-	sec_halt = sec_run | 0x80;                // CH=1 (halt)
-	min  = bin2bcd(mi);
-	hour = bin2bcd(h);                        // 24h
-	mday = bin2bcd(d);
-	mon  = bin2bcd(mon0 + 1);
-	wday = bin2bcd(w0 + 1);                   // 0~6 -> 1~7
-	year = bin2bcd(y);
+	buf[0] = bin2bcd(s) & 0x7F;               // CH=0
+	buf[1] = bin2bcd(mi);
+	buf[2] = bin2bcd(h);                      // 24h
+	buf[3] = bin2bcd(d);
+	buf[4] = bin2bcd(mon0 + 1);
+	buf[5] = bin2bcd(w0 + 1);                 // 0~6 -> 1~7
+	buf[6] = bin2bcd(y);
+	buf[7] = 0x80;                            // WP=1 (burst 끝에서 다시 잠금)
 
 	mutex_lock(&p->lock);
 
-	ds1302_write_protect(false);
+	ds1302_write_protect(p, false);
 
-	// ✅ 안전하게: 멈춘 상태(CH=1)로 초 먼저 써서 스톱 -> 나머지 -> 마지막에 CH=0로 재시작
-	ds1302_write_reg_raw(DS1302_REG_SECONDS, sec_halt);
+	// ✅ burst write는 CE 한 번에 8바이트가 같이 반영돼서 중간에 멈출(CH=1) 필요 없음
+	ds1302_write_burst(p, DS1302_CMD_CLOCK_BURST, buf, DS1302_CLOCK_BURST_LEN);
 
-	ds1302_write_reg_raw(DS1302_REG_MINUTES, min);
-	ds1302_write_reg_raw(DS1302_REG_HOURS,   hour);
-	ds1302_write_reg_raw(DS1302_REG_DATE,    mday);
-	ds1302_write_reg_raw(DS1302_REG_MONTH,   mon);
-	ds1302_write_reg_raw(DS1302_REG_DAY,     wday);
-	ds1302_write_reg_raw(DS1302_REG_YEAR,    year);
+	// 초 레지스터를 쓰는 순간 칩의 분주기가 리셋되므로, 여기서 잡은 anchor는 위상까지 정확
+	t.tm_sec  = s;
+	t.tm_min  = mi;
+	t.tm_hour = h;
+	t.tm_mday = d;
+	t.tm_mon  = mon0;
+	t.tm_year = 100 + y;
+	ds1302_cache_set(p, rtc_tm_to_time64(&t), ktime_get(), true);
 
-	ds1302_write_reg_raw(DS1302_REG_SECONDS, sec_run); // CH=0, start
+	mutex_unlock(&p->lock);
+	return 0;
+}
+
+// ====== 알람 / UIE ======
+// DS1302엔 알람 핀이 없어서 anchor(위상 맞춘 초 경계) 기준 hrtimer로 에뮬레이션.
+// rtc core가 UIE(RTC_UIE_ON)를 "다음 초 알람"으로 구현하므로 이것만으로
+// /dev/rtcX 의 blocking read/poll 이 칩의 초 경계에 맞춰 깨어난다.
+static void ds1302_alarm_arm(struct ds1302_priv *p)
+{
+	unsigned long flags;
+	ktime_t expires = 0;
+	bool arm;
+
+	spin_lock_irqsave(&p->cache_lock, flags);
+	arm = p->alarm_enabled && !p->alarm_fired && p->cache_valid;
+	if (arm)
+		expires = ktime_add(p->cache_kt,
+		                    ns_to_ktime((p->alarm_secs - p->cache_secs) * NSEC_PER_SEC));
+	spin_unlock_irqrestore(&p->cache_lock, flags);
+
+	if (arm)
+		hrtimer_start(&p->alarm_timer, expires, HRTIMER_MODE_ABS);
+	else
+		hrtimer_try_to_cancel(&p->alarm_timer);
+}
+
+static enum hrtimer_restart ds1302_alarm_timer_fn(struct hrtimer *t)
+{
+	struct ds1302_priv *p = container_of(t, struct ds1302_priv, alarm_timer);
+	unsigned long flags;
 
-	ds1302_write_protect(true);
+	spin_lock_irqsave(&p->cache_lock, flags);
+	p->alarm_fired = true;   // 같은 알람이 anchor 갱신 때 다시 울리지 않게
+	spin_unlock_irqrestore(&p->cache_lock, flags);
+
+	rtc_update_irq(p->rtc, 1, RTC_AF | RTC_IRQF);
+	return HRTIMER_NORESTART;
+}
+
+// 알람 계산엔 anchor가 필요하니 한 번도 안 읽었으면 먼저 읽어둠
+static void ds1302_alarm_prepare(struct device *dev, struct ds1302_priv *p)
+{
+	struct rtc_time tm;
+
+	if (!p->cache_valid)
+		ds1302_rtc_read_time(dev, &tm);
+}
 
+static int ds1302_rtc_read_alarm(struct device *dev, struct rtc_wkalrm *alrm)
+{
+	struct ds1302_priv *p = ds_priv_from_dev(dev);
+	unsigned long flags;
+	time64_t secs;
+
+	if (!p)
+		return -ENODEV;
+
+	spin_lock_irqsave(&p->cache_lock, flags);
+	secs = p->alarm_secs;
+	alrm->enabled = p->alarm_enabled;
+	alrm->pending = p->alarm_enabled && p->alarm_fired;
+	spin_unlock_irqrestore(&p->cache_lock, flags);
+
+	rtc_time64_to_tm(secs, &alrm->time);
+	return 0;
+}
+
+static int ds1302_rtc_set_alarm(struct device *dev, struct rtc_wkalrm *alrm)
+{
+	struct ds1302_priv *p = ds_priv_from_dev(dev);
+	unsigned long flags;
+
+	if (!p)
+		return -ENODEV;
+
+	ds1302_alarm_prepare(dev, p);
+
+	spin_lock_irqsave(&p->cache_lock, flags);
+	p->alarm_secs    = rtc_tm_to_time64(&alrm->time);
+	p->alarm_enabled = alrm->enabled;
+	p->alarm_fired   = false;
+	spin_unlock_irqrestore(&p->cache_lock, flags);
+
+	ds1302_alarm_arm(p);
+	return 0;
+}
+
+static int ds1302_rtc_alarm_irq_enable(struct device *dev, unsigned int enabled)
+{
+	struct ds1302_priv *p = ds_priv_from_dev(dev);
+	unsigned long flags;
+
+	if (!p)
+		return -ENODEV;
+
+	ds1302_alarm_prepare(dev, p);
+
+	spin_lock_irqsave(&p->cache_lock, flags);
+	p->alarm_enabled = !!enabled;
+	spin_unlock_irqrestore(&p->cache_lock, flags);
+
+	ds1302_alarm_arm(p);
+	return 0;
+}
+
+// ====== NVRAM (nvmem provider) ======
+// p->lock 잡은 상태에서 호출
+static void ds1302_nvram_load(struct ds1302_priv *p)
+{
+	if (p->ram_valid)
+		return;
+	ds1302_read_burst(p, DS1302_CMD_RAM_BURST, p->ram, DS1302_RAM_SIZE);
+	p->ram_valid = true;
+}
+
+static void ds1302_nvram_flush(struct ds1302_priv *p)
+{
+	mutex_lock(&p->lock);
+	if (p->ram_dirty_end > 0) {
+		ds1302_write_protect(p, false);
+		ds1302_write_burst(p, DS1302_CMD_RAM_BURST, p->ram, p->ram_dirty_end);
+		ds1302_write_protect(p, true);
+		p->ram_dirty_end = 0;
+	}
+	mutex_unlock(&p->lock);
+}
+
+static void ds1302_ram_work_fn(struct work_struct *work)
+{
+	struct ds1302_priv *p = container_of(to_delayed_work(work), struct ds1302_priv, ram_work);
+
+	ds1302_nvram_flush(p);
+}
+
+static int ds1302_nvram_read(void *priv, unsigned int off, void *val, size_t bytes)
+{
+	struct ds1302_priv *p = priv;
+
+	mutex_lock(&p->lock);
+	ds1302_nvram_load(p);
+	memcpy(val, &p->ram[off], bytes);
 	mutex_unlock(&p->lock);
 	return 0;
 }
 
+static int ds1302_nvram_write(void *priv, unsigned int off, void *val, size_t bytes)
+{
+	struct ds1302_priv *p = priv;
+
+	mutex_lock(&p->lock);
+	ds1302_nvram_load(p);   // burst write가 RAM0부터라 앞부분도 캐시에 있어야 함
+	memcpy(&p->ram[off], val, bytes);
+	if (off + bytes > p->ram_dirty_end)
+		p->ram_dirty_end = off + bytes;
+	mutex_unlock(&p->lock);
+
+	// 연달아 오는 작은 쓰기(카운터 여러 개 등)를 burst 한 번으로 묶음
+	if (nvram_writeback_ms > 0)
+		schedule_delayed_work(&p->ram_work, msecs_to_jiffies(nvram_writeback_ms));
+	else
+		ds1302_nvram_flush(p);
+	return 0;
+}
+
+// devm action: nvmem 등록이 풀린 뒤(새 reg_write 없음) 실행 -> 남은 쓰기를 GPIO 반납 전에 반영
+static void ds1302_nvram_stop(void *data)
+{
+	struct ds1302_priv *p = data;
+
+	cancel_delayed_work_sync(&p->ram_work);
+	ds1302_nvram_flush(p);
+}
+
+static void ds1302_nvram_register(struct platform_device *pdev, struct ds1302_priv *p)
+{
+	struct nvmem_config cfg = {
+		.name      = "ds1302_nvram",
+		.id        = NVMEM_DEVID_AUTO,
+		.owner     = THIS_MODULE,
+		.dev       = &pdev->dev,
+		.type      = NVMEM_TYPE_BATTERY_BACKED,
+		.size      = DS1302_RAM_SIZE,
+		.word_size = 1,
+		.stride    = 1,
+		.reg_read  = ds1302_nvram_read,
+		.reg_write = ds1302_nvram_write,
+		.priv      = p,
+	};
+
+	// NVRAM은 부가 기능이라 실패해도 RTC는 계속 동작
+	if (devm_add_action_or_reset(&pdev->dev, ds1302_nvram_stop, p)) {
+		dev_warn(&pdev->dev, "NVRAM not exposed\n");
+		return;
+	}
+	p->nvmem = devm_nvmem_register(&pdev->dev, &cfg);
+	if (IS_ERR(p->nvmem)) {
+		dev_warn(&pdev->dev, "nvmem register failed (%ld), NVRAM not exposed\n",
+		         PTR_ERR(p->nvmem));
+		p->nvmem = NULL;
+	}
+}
+
 static const struct rtc_class_ops ds1302_rtc_ops = {
-	.read_time = ds1302_rtc_read_time,
-	.set_time  = ds1302_rtc_set_time,
+	.read_time        = ds1302_rtc_read_time,
+	.set_time         = ds1302_rtc_set_time,
+	.read_alarm       = ds1302_rtc_read_alarm,
+	.set_alarm        = ds1302_rtc_set_alarm,
+	.alarm_irq_enable = ds1302_rtc_alarm_irq_enable,
 };
 
-static int ds1302_request_gpios(void)
+// ====== bit-bang 벤치마크 ======
+// clock burst read(7바이트)를 여러 번 돌려서 트랜잭션당 시간 측정
+#define DS1302_BENCH_ROUNDS 32
+
+static void ds1302_bench(struct ds1302_priv *p, u32 *avg_ns, u32 *min_ns, u32 *max_ns)
 {
-	int ret;
+	u8 buf[7];
+	u64 sum = 0;
+	int i;
 
-	if (!gpio_is_valid(gpio_clk) || !gpio_is_valid(gpio_io) || !gpio_is_valid(gpio_ce))
-		return -EINVAL;
+	*min_ns = U32_MAX;
+	*max_ns = 0;
 
-	ret = gpio_request(gpio_clk, DRV_NAME "_clk");
-	if (ret) return ret;
-	ret = gpio_request(gpio_io,  DRV_NAME "_io");
-	if (ret) { gpio_free(gpio_clk); return ret; }
-	ret = gpio_request(gpio_ce,  DRV_NAME "_ce");
-	if (ret) { gpio_free(gpio_io); gpio_free(gpio_clk); return ret; }
+	mutex_lock(&p->lock);
+	for (i = 0; i < DS1302_BENCH_ROUNDS; i++) {
+		ds1302_read_burst(p, DS1302_CMD_CLOCK_BURST, buf, 7);
+		sum += p->xfer_ns_last;
+		*min_ns = min(*min_ns, p->xfer_ns_last);
+		*max_ns = max(*max_ns, p->xfer_ns_last);
+	}
+	mutex_unlock(&p->lock);
+
+	*avg_ns = (u32)div_u64(sum, DS1302_BENCH_ROUNDS);
+}
 
-	gpio_direction_output(gpio_clk, 0);
-	gpio_direction_output(gpio_ce,  0);
-	gpio_direction_output(gpio_io,  0);
+// cat /sys/class/rtc/rtcX/device/xfer_bench
+static ssize_t xfer_bench_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct ds1302_priv *p = dev_get_drvdata(dev);
+	u32 avg, mn, mx;
 
-	return 0;
+	ds1302_bench(p, &avg, &mn, &mx);
+	return sysfs_emit(buf, "clock_burst_read us/xfer: avg %u.%03u min %u.%03u max %u.%03u (n=%d)\n",
+	                  avg / 1000, avg % 1000, mn / 1000, mn % 1000, mx / 1000, mx % 1000,
+	                  DS1302_BENCH_ROUNDS);
+}
+static DEVICE_ATTR_RO(xfer_bench);
+
+static struct attribute *ds1302_attrs[] = {
+	&dev_attr_xfer_bench.attr,
+	NULL,
+};
+static const struct attribute_group ds1302_group = {
+	.attrs = ds1302_attrs,
+};
+
+// stats/: 파일 하나에 값 하나 (xfer_bench와 달리 버스를 안 건드림)
+#define DS1302_STAT_ATTR(field)							\
+static ssize_t field##_show(struct device *dev, struct device_attribute *attr, char *buf)	\
+{										\
+	struct ds1302_priv *p = dev_get_drvdata(dev);				\
+	u64 v;									\
+	mutex_lock(&p->lock);							\
+	v = p->field;								\
+	mutex_unlock(&p->lock);							\
+	return sysfs_emit(buf, "%llu\n", v);					\
+}										\
+static DEVICE_ATTR_RO(field)
+
+DS1302_STAT_ATTR(xfer_count);
+DS1302_STAT_ATTR(xfer_ns_total);
+DS1302_STAT_ATTR(xfer_ns_max);
+DS1302_STAT_ATTR(chip_reads);
+DS1302_STAT_ATTR(bad_reads);
+
+static ssize_t cache_hits_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct ds1302_priv *p = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%lld\n", atomic64_read(&p->cache_hits));
+}
+static DEVICE_ATTR_RO(cache_hits);
+
+static struct attribute *ds1302_stats_attrs[] = {
+	&dev_attr_xfer_count.attr,
+	&dev_attr_xfer_ns_total.attr,
+	&dev_attr_xfer_ns_max.attr,
+	&dev_attr_chip_reads.attr,
+	&dev_attr_bad_reads.attr,
+	&dev_attr_cache_hits.attr,
+	NULL,
+};
+static const struct attribute_group ds1302_stats_group = {
+	.name  = "stats",
+	.attrs = ds1302_stats_attrs,
+};
+
+static const struct attribute_group *ds1302_groups[] = {
+	&ds1302_group,
+	&ds1302_stats_group,
+	NULL,
+};
+
+// DT/gpiod lookup에서 "<con>-gpios"를 찾고, 없으면 platform data의 BCM 번호로 fallback
+static struct gpio_desc *ds1302_get_gpio(struct device *dev, const char *con, int legacy)
+{
+	struct gpio_desc *d;
+	char label[24];
+	int ret;
+
+	d = devm_gpiod_get_optional(dev, con, GPIOD_OUT_LOW);
+	if (d)
+		return d;   // 찾았거나 에러(-EPROBE_DEFER 포함)
+
+	if (legacy < 0 || !gpio_is_valid(legacy))
+		return ERR_PTR(-ENOENT);
+
+	snprintf(label, sizeof(label), DRV_NAME "_%s", con);
+	ret = devm_gpio_request_one(dev, legacy, GPIOF_OUT_INIT_LOW,
+	                            devm_kstrdup(dev, label, GFP_KERNEL));
+	if (ret)
+		return ERR_PTR(ret);
+	return gpio_to_desc(legacy);
 }
 
-static void ds1302_free_gpios(void)
+// devm action: RTC 등록이 풀린 뒤에 실행되므로 다시 arm/schedule 될 경로가 없음
+static void ds1302_stop_timers(void *data)
 {
-	gpio_set_value(gpio_ce, 0);
-	gpio_set_value(gpio_clk, 0);
+	struct ds1302_priv *p = data;
 
-	gpio_free(gpio_ce);
-	gpio_free(gpio_io);
-	gpio_free(gpio_clk);
+	cancel_delayed_work_sync(&p->phase_work);
+	hrtimer_cancel(&p->alarm_timer);
 }
 
 static int ds1302_probe(struct platform_device *pdev)
 {
+	struct device *dev = &pdev->dev;
+	struct ds1302_pdata *pd = dev_get_platdata(dev);
 	struct ds1302_priv *p;
 	int ret;
 
-	ret = ds1302_request_gpios();
-	if (ret) return ret;
-
-	p = devm_kzalloc(&pdev->dev, sizeof(*p), GFP_KERNEL);
-	if (!p) {
-		ds1302_free_gpios();
+	p = devm_kzalloc(dev, sizeof(*p), GFP_KERNEL);
+	if (!p)
 		return -ENOMEM;
-	}
+
+	p->clk = ds1302_get_gpio(dev, "clk", pd ? pd->clk : -1);
+	if (IS_ERR(p->clk))
+		return dev_err_probe(dev, PTR_ERR(p->clk), "clk gpio\n");
+	p->io = ds1302_get_gpio(dev, "io", pd ? pd->io : -1);
+	if (IS_ERR(p->io))
+		return dev_err_probe(dev, PTR_ERR(p->io), "io gpio\n");
+	p->ce = ds1302_get_gpio(dev, "ce", pd ? pd->ce : -1);
+	if (IS_ERR(p->ce))
+		return dev_err_probe(dev, PTR_ERR(p->ce), "ce gpio\n");
+
+	ds1302_timing_init(p, vcc_mv);
 
 	mutex_init(&p->lock);
+	spin_lock_init(&p->cache_lock);
+	INIT_DELAYED_WORK(&p->phase_work, ds1302_phase_work_fn);
+	INIT_DELAYED_WORK(&p->ram_work, ds1302_ram_work_fn);
+	hrtimer_init(&p->alarm_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	p->alarm_timer.function = ds1302_alarm_timer_fn;
 	platform_set_drvdata(pdev, p);
 
-	// ✅ fallback 세팅(혹시 drvdata 못 찾는 케이스 방어)
-	g_priv = p;
-
-	// ✅ 모듈 로드 시 오실레이터(Clock Halt) 풀어주기
+	// ✅ 로드 시 오실레이터(Clock Halt) 풀어주기
 	ds1302_ensure_osc_running(p);
 
-	p->rtc = devm_rtc_device_register(&pdev->dev, DRV_NAME, &ds1302_rtc_ops, THIS_MODULE);
-	if (IS_ERR(p->rtc)) {
-		ret = PTR_ERR(p->rtc);
-		g_priv = NULL;
-		ds1302_free_gpios();
+	// allocate -> 정지 action -> register 순서: 해제는 역순이라
+	// RTC 등록 해제(새 set_alarm/read_time 없음) -> 타이머/phase_work 정지 -> rtc_device 해제
+	p->rtc = devm_rtc_allocate_device(dev);
+	if (IS_ERR(p->rtc))
+		return PTR_ERR(p->rtc);
+	p->rtc->ops = &ds1302_rtc_ops;
+
+	ret = devm_add_action_or_reset(dev, ds1302_stop_timers, p);
+	if (ret)
 		return ret;
-	}
 
-	// ✅ rtc device에서도 drvdata를 바로 찾을 수 있게 세팅
-	dev_set_drvdata(&p->rtc->dev, p);
+	ret = devm_rtc_register_device(p->rtc);
+	if (ret)
+		return ret;
+
+	// 초 경계 찾아서 anchor 위상 맞추기 (알람/UIE 정렬용, 백그라운드)
+	schedule_delayed_work(&p->phase_work, 0);
+
+	// 31바이트 배터리 RAM -> /sys/bus/nvmem/devices/ds1302_nvramN/nvmem
+	ds1302_nvram_register(pdev, p);
+
+	dev_info(dev, "loaded (CLK=%d IO=%d CE=%d) -> /dev/%s\n",
+	         desc_to_gpio(p->clk), desc_to_gpio(p->io), desc_to_gpio(p->ce),
+	         dev_name(&p->rtc->dev));
 
-	dev_info(&pdev->dev, "loaded (CLK=%d IO=%d CE=%d) -> /dev/rtcX\n",
-	         gpio_clk, gpio_io, gpio_ce);
+	{
+		u32 avg, mn, mx;
+
+		ds1302_bench(p, &avg, &mn, &mx);
+		dev_info(dev, "bit-bang @%dmV: %u.%03u us per clock burst read\n",
+		         vcc_mv, avg / 1000, avg % 1000);
+	}
 	return 0;
 }
 
 static int ds1302_remove(struct platform_device *pdev)
 {
 	struct ds1302_priv *p = platform_get_drvdata(pdev);
-	if (g_priv == p)
-		g_priv = NULL;
 
-	ds1302_free_gpios();
+	// 타이머/phase_work/NVRAM write-back 정지는 devm action이 등록 해제 뒤에 처리
+	// GPIO 자체는 devm이 반납
+	gpiod_set_value(p->ce, 0);
+	gpiod_set_value(p->clk, 0);
 	return 0;
 }
 
+static const struct of_device_id ds1302_of_match[] = {
+	{ .compatible = "rpi,ds1302-gpio" },
+	{ }
+};
+MODULE_DEVICE_TABLE(of, ds1302_of_match);
+
 static struct platform_driver ds1302_driver = {
 	.probe  = ds1302_probe,
 	.remove = ds1302_remove,
 	.driver = {
-		.name = DRV_NAME,
+		.name           = DRV_NAME,
+		.of_match_table = ds1302_of_match,
+		.dev_groups     = ds1302_groups,
+		// bit-bang(osc 확인, 벤치, nvmem)이 부팅 크리티컬 경로를 막지 않게
+		.probe_type     = PROBE_PREFER_ASYNCHRONOUS,
 	},
 };
 
-// 우리가 DT로 붙이는 게 아니라서 가짜 platform_device 하나 만들어 probe 트리거
+// DT 노드가 없는 보드(기존 배선)용: module param 번호로 platform_device 하나 만들어 probe 트리거
 static struct platform_device *ds1302_pdev;
 
 static int __init ds1302_mod_init(void)
 {
+	struct ds1302_pdata pd = { .clk = gpio_clk, .io = gpio_io, .ce = gpio_ce };
+	struct device_node *np;
 	int ret;
 
 	ret = platform_driver_register(&ds1302_driver);
 	if (ret) return ret;
 
-	ds1302_pdev = platform_device_register_simple(DRV_NAME, -1, NULL, 0);
+	np = of_find_compatible_node(NULL, NULL, "rpi,ds1302-gpio");
+	if (np) {
+		of_node_put(np);
+		return 0;   // DT 인스턴스가 있으면 그쪽만
+	}
+	if (!legacy_device)
+		return 0;
+
+	ds1302_pdev = platform_device_register_data(NULL, DRV_NAME, PLATFORM_DEVID_NONE,
+	                                            &pd, sizeof(pd));
 	if (IS_ERR(ds1302_pdev)) {
 		ret = PTR_ERR(ds1302_pdev);
+		ds1302_pdev = NULL;
 		platform_driver_unregister(&ds1302_driver);
 		return ret;
 	}
@@ -389,7 +1009,8 @@ static int __init ds1302_mod_init(void)
 
 static void __exit ds1302_mod_exit(void)
 {
-	platform_device_unregister(ds1302_pdev);
+	if (ds1302_pdev)
+		platform_device_unregister(ds1302_pdev);
 	platform_driver_unregister(&ds1302_driver);
 }
 
@@ -399,4 +1020,4 @@ module_exit(ds1302_mod_exit);
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("minseong");
 MODULE_DESCRIPTION("DS1302 RTC driver (GPIO bit-bang) for Raspberry Pi wiring");
-MODULE_VERSION("0.4");
+MODULE_VERSION("0.6");
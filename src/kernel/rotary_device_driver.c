@@ -9,15 +9,26 @@
 #include <linux/wait.h>
 #include <linux/jiffies.h>
 #include <linux/poll.h>
+#include <linux/input.h>
+#include <linux/spinlock.h>
+#include <linux/timer.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/ioctl.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/hrtimer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/log2.h>
+#include <linux/sysfs.h>
 
 #define DRIVER_NAME "rotary_device_driver"
 #define CLASS_NAME  "rotary_device_class"
-#define DEV_NAME    "rotary"
+#define DEV_NAME    "rotary"   /* /dev/rotary0, /dev/rotary1, ... */
 
-/* === 너 배선 고정 === */
-#define S1_GPIO   17
-#define S2_GPIO   27
-#define KEY_GPIO  22
+/* 엔코더 최대 개수 */
+#define ROTARY_MAX  4
 
 /* 디바운스(필요하면 조절) */
 #define ROT_DEBOUNCE_MS  3
@@ -27,34 +38,148 @@ MODULE_LICENSE("GPL");
 MODULE_AUTHOR("kkk + patched");
 MODULE_DESCRIPTION("rotary + key driver");
 
-/* ====== chardev ====== */
-static dev_t device_number;
-static struct cdev rotary_cdev;
-static struct class *rotary_class;
+/* ====== 배선 (BCM) ======
+   엔코더 N개 = s1_gpios/s2_gpios에 N개씩. 기본값은 기존 보드 배선 1개.
+   예) insmod rotary_device_driver.ko s1_gpios=17,5 s2_gpios=27,6 key_gpios=22,-1
+   key_gpios가 -1이거나 모자라면 그 엔코더는 버튼 없음. */
+static int s1_gpios[ROTARY_MAX]  = {17};
+static int s2_gpios[ROTARY_MAX]  = {27};
+static int key_gpios[ROTARY_MAX] = {22};
+static int s1_num = 1, s2_num = 1, key_num = 1;
+module_param_array(s1_gpios, int, &s1_num, 0444);
+module_param_array(s2_gpios, int, &s2_num, 0444);
+module_param_array(key_gpios, int, &key_num, 0444);
+
+/* 이 간격보다 오래 쉬면 속도 0에서 다시 시작 */
+#define ROT_IDLE_MS  250
+
+/* ====== 이벤트 큐(작게) ======
+   open 한 파일마다 자기 큐/커서를 가진다. ISR은 모든 reader 큐에 복사(fan-out)하고,
+   느린 reader는 자기 큐만 넘쳐서 drops가 늘 뿐 다른 reader에 영향 없음.
+   제스처(EV_CLICK~)는 ROTARY_IOCTL_SET_MASK로 켠 reader에게만 간다. */
+enum {
+	EV_ROTATE = 0,
+	EV_KEY,           /* press 즉시 (기존 "K") */
+	EV_CLICK,         /* 짧게 눌렀다 뗌, double_click_ms 안에 두 번째 클릭 없음 */
+	EV_DCLICK,        /* double_click_ms 안에 두 번 클릭 */
+	EV_LONG,          /* long_press_ms 이상 누르고 있음 (뗄 때까지 기다리지 않음) */
+	EV_PRESS_ROTATE,  /* 누른 채로 회전 (EV_ROTATE와 별도로 한 번 더 옴) */
+};
+
+struct rot_event {
+	int type;   // EV_*
+	int value;  // rotate/press_rotate: delta, 나머지: 1
+	long total; // push 시점의 value 누적
+	int velocity; // push 시점의 속도 (detent/s)
+	u64 t_ns;     // 원인 엣지의 hardirq 시각 (ktime_get_ns). 합쳐진 경우 가장 이른 것
+};
 
-/* ====== irq ====== */
-static int irq_s1;
-static int irq_key;
+/* IRQ -> read() 지연 히스토그램: 버킷 i = [2^(i-1), 2^i) us, 0 = 1us 미만 */
+#define LAT_BUCKETS 24
 
-/* ====== 상태 ====== */
-static long rotary_value;
+#define QSIZE 32
 
-/* ====== 이벤트 큐(작게) ====== */
-enum { EV_ROTATE = 0, EV_KEY = 1 };
+struct rotary_dev;
+
+struct rotary_reader {
+	struct list_head node;
+	struct rotary_dev *rdev;
+	struct rot_event q[QSIZE];
+	int qh, qt;
+	u32 events;  /* open 이후 받은 이벤트 수 */
+	u32 drops;   /* 큐가 가득 차서 버린 수 */
+	u32 coalesced; /* 앞 회전 이벤트에 합쳐진 수 */
+	u32 evmask;    /* 받을 이벤트 종류 (BIT(EV_*)) + ROTARY_READ_STAMP */
+};
 
-struct rot_event {
-	int type;   // EV_ROTATE / EV_KEY
-	int value;  // rotate: +1/-1, key: 1
+/* ====== 엔코더 1개 단위 상태 ======
+   락/큐/타이머가 전부 인스턴스마다 따로라서 엔코더끼리 ISR이 서로 안 막힌다. */
+struct rotary_dev {
+	int index;
+	int s1_gpio, s2_gpio, key_gpio;   /* key_gpio < 0 이면 버튼 없음 */
+	int irq_s1, irq_key;
+	char name_s1[24], name_key[24], phys[32];
+
+	struct cdev cdev;
+	struct device *dev;
+	struct input_dev *input;
+
+	/* 상태 */
+	long value;
+	int velocity;          /* 회전 속도(detent/s, EWMA) - 엣지 간격으로 계산 */
+	ktime_t last_rot_kt;
+	int last_rot_dir;
+	unsigned long last_rot_j;
+	unsigned long last_key_j;
+
+	/* 마지막으로 보고한 키 상태 + 디바운스 중 놓친 엣지 재확인용 타이머 */
+	int key_down;
+	struct timer_list key_timer;
+
+	/* reader 목록 + 각 reader 큐 */
+	struct list_head readers;
+	spinlock_t q_lock;
+	wait_queue_head_t wait;
+
+	/* 제스처: press/release 시각으로 판정하고, 시간 조건은 hrtimer가 처리해서
+	   userspace가 타이머를 돌릴 필요가 없게 함 */
+	spinlock_t gst_lock;
+	struct hrtimer long_timer;   /* press 후 long_press_ms */
+	struct hrtimer dbl_timer;    /* 첫 클릭 release 후 double_click_ms */
+	ktime_t key_press_kt;
+	bool gst_consumed;           /* 이번 press는 long/press+rotate로 이미 소비됨 */
+	bool click_pending;          /* 첫 클릭 후 두 번째 클릭 대기 중 */
+
+	/* 디바운스 창 안에서 미뤄진 키 엣지의 시각 (key_timer가 처리할 때 사용) */
+	u64 key_pend_ns;
+
+	/* debugfs 지연 히스토그램 (q_lock으로 보호) */
+	u32 lat_hist[LAT_BUCKETS];
+	u64 lat_max_ns;
+	struct dentry *dbg;
+
+	/* 장치 전체 누적 카운터 (/sys/class/rotary_device_class/rotaryN/stats/, q_lock)
+	   reader별 값(ROTARY_IOCTL_STATS)과 달리 open/close와 상관없이 계속 쌓임 */
+	struct {
+		u64 irqs;        /* S1/KEY 인터럽트 */
+		u64 bounces;     /* 디바운스 창 안이라 버린 엣지 */
+		u64 events;      /* 큐에 넣은 이벤트 (reader 수와 무관하게 1번) */
+		u64 drops;       /* 모든 reader의 overflow 합 */
+		u64 coalesced;
+		u64 reads;       /* read()로 나간 이벤트 */
+		u64 read_ns_total;   /* IRQ -> read() 합 */
+	} st;
 };
 
-#define QSIZE 32
-static struct rot_event q[QSIZE];
-static int qh, qt;
+/* ====== chardev ====== */
+static dev_t device_number;
+static struct class *rotary_class;
+static struct rotary_dev rotary_devs[ROTARY_MAX];
+static int rotary_count;
+static struct dentry *rotary_dbg_root;
+
+/* ====== ioctl ====== */
+#define ROTARY_IOCTL_MAGIC 'r'
+struct rotary_stats {
+	__u32 queued;  /* 지금 큐에 남은 이벤트 */
+	__u32 events;  /* open 이후 받은 이벤트 */
+	__u32 drops;   /* overflow로 버린 이벤트 */
+	__u32 coalesced; /* 읽히기 전 앞 회전 이벤트에 합쳐진 이벤트 */
+	__s32 velocity;  /* 현재 회전 속도 (detent/s) */
+};
+#define ROTARY_IOCTL_STATS _IOR(ROTARY_IOCTL_MAGIC, 0x01, struct rotary_stats)
+#define ROTARY_IOCTL_RESET _IO(ROTARY_IOCTL_MAGIC, 0x02)  /* events/drops 0으로 */
+#define ROTARY_IOCTL_SET_MASK _IOW(ROTARY_IOCTL_MAGIC, 0x03, __u32) /* BIT(EV_*) 조합 */
 
-static DECLARE_WAIT_QUEUE_HEAD(rotary_wait_queue);
+#define ROTARY_EVMASK_DEFAULT (BIT(EV_ROTATE) | BIT(EV_KEY))
+#define ROTARY_EVMASK_ALL     (BIT(EV_PRESS_ROTATE + 1) - 1)
+/* 이벤트 종류가 아니라 read 형식 옵션: 켠 reader만 줄 끝에 " @<irq ns>" (기본 꺼짐) */
+#define ROTARY_READ_STAMP     BIT(31)
 
-static unsigned long last_rot_j;
-static unsigned long last_key_j;
+static int long_press_ms = 600;
+module_param(long_press_ms, int, 0644);
+static int double_click_ms = 300;
+module_param(double_click_ms, int, 0644);
 
 /* 키 active-low 여부 (대부분 pull-up이라 눌림=0) */
 static int key_active_low = 1;
@@ -64,95 +189,431 @@ module_param(key_active_low, int, 0444);
 static int invert_dir = 0;
 module_param(invert_dir, int, 0444);
 
-static inline int q_empty(void) { return qh == qt; }
-static inline int q_full(void)  { return ((qh + 1) % QSIZE) == qt; }
+/* evdev 회전 축: 0=REL_DIAL, 1=REL_WHEEL */
+static int input_wheel = 0;
+module_param(input_wheel, int, 0444);
+
+/* evdev 버튼 키코드 (기본 KEY_ENTER) */
+static int input_keycode = KEY_ENTER;
+module_param(input_keycode, int, 0444);
+
+/* reader가 아직 안 읽은 같은 방향 회전 이벤트에 delta를 합침 */
+static int coalesce = 1;
+module_param(coalesce, int, 0644);
+
+/* 가속: 속도가 accel_min_vel(detent/s)의 N배면 delta도 N배 (최대 accel_max배)
+   evdev엔 항상 원래 step을 보고(가속은 libinput 쪽 몫) */
+static int accel = 0;
+module_param(accel, int, 0644);
+static int accel_min_vel = 10;
+module_param(accel_min_vel, int, 0644);
+static int accel_max = 8;
+module_param(accel_max, int, 0644);
+
+static inline int q_empty(const struct rotary_reader *rd) { return rd->qh == rd->qt; }
+static inline int q_full(const struct rotary_reader *rd)  { return ((rd->qh + 1) % QSIZE) == rd->qt; }
+static inline int q_count(const struct rotary_reader *rd) { return (rd->qh - rd->qt + QSIZE) % QSIZE; }
+
+/* ISR(hardirq)와 key_timer(softirq) 양쪽에서 push 하므로 irqsave
+   t_ns = 이벤트를 만든 엣지의 시각 */
+static void q_push_ts(struct rotary_dev *rdev, int type, int value, u64 t_ns)
+{
+	struct rotary_reader *rd;
+	unsigned long flags;
+
+	spin_lock_irqsave(&rdev->q_lock, flags);
+	rdev->st.events++;
+	list_for_each_entry(rd, &rdev->readers, node) {
+		struct rot_event *last = &rd->q[(rd->qh + QSIZE - 1) % QSIZE];
+
+		if (!(rd->evmask & BIT(type)))
+			continue;
+
+		rd->events++;
+
+		/* 밀려 있으면 마지막 회전 이벤트에 합쳐서 큐를 짧게 유지 */
+		if (coalesce && (type == EV_ROTATE || type == EV_PRESS_ROTATE) &&
+		    !q_empty(rd) && last->type == type &&
+		    (last->value > 0) == (value > 0)) {
+			last->value   += value;
+			last->total    = rdev->value;
+			last->velocity = rdev->velocity;
+			rd->coalesced++;
+			rdev->st.coalesced++;
+			continue;
+		}
+
+		if (q_full(rd)) {
+			rd->drops++;
+			rdev->st.drops++;
+			continue;
+		}
+		rd->q[rd->qh].type     = type;
+		rd->q[rd->qh].value    = value;
+		rd->q[rd->qh].total    = rdev->value;
+		rd->q[rd->qh].velocity = rdev->velocity;
+		rd->q[rd->qh].t_ns     = t_ns;
+		rd->qh = (rd->qh + 1) % QSIZE;
+	}
+	spin_unlock_irqrestore(&rdev->q_lock, flags);
+	wake_up_interruptible(&rdev->wait);
+}
+
+/* 제스처(hrtimer)처럼 판정 시점이 곧 이벤트 시각인 경우 */
+static void q_push(struct rotary_dev *rdev, int type, int value)
+{
+	q_push_ts(rdev, type, value, ktime_get_ns());
+}
+
+/* read()가 이벤트를 꺼낸 시점 - 엣지 시각 */
+static void rotary_lat_add(struct rotary_dev *rdev, u64 t_ns)
+{
+	u64 d = ktime_get_ns() - t_ns;
+	u64 us = div_u64(d, NSEC_PER_USEC);
+	int b = us ? ilog2(us) + 1 : 0;
+	unsigned long flags;
+
+	if (b >= LAT_BUCKETS)
+		b = LAT_BUCKETS - 1;
+
+	spin_lock_irqsave(&rdev->q_lock, flags);
+	rdev->lat_hist[b]++;
+	if (d > rdev->lat_max_ns)
+		rdev->lat_max_ns = d;
+	rdev->st.reads++;
+	rdev->st.read_ns_total += d;
+	spin_unlock_irqrestore(&rdev->q_lock, flags);
+}
 
-static void q_push(int type, int value)
+static int q_pop(struct rotary_reader *rd, struct rot_event *out)
 {
-	if (!q_full()) {
-		q[qh].type  = type;
-		q[qh].value = value;
-		qh = (qh + 1) % QSIZE;
+	struct rotary_dev *rdev = rd->rdev;
+	unsigned long flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&rdev->q_lock, flags);
+	if (!q_empty(rd)) {
+		*out = rd->q[rd->qt];
+		rd->qt = (rd->qt + 1) % QSIZE;
+		ret = 1;
 	}
-	wake_up_interruptible(&rotary_wait_queue);
+	spin_unlock_irqrestore(&rdev->q_lock, flags);
+	return ret;
 }
 
-static int q_pop(struct rot_event *out)
+static void rotary_count_irq(struct rotary_dev *rdev, bool bounce)
 {
-	if (q_empty())
-		return 0;
-	*out = q[qt];
-	qt = (qt + 1) % QSIZE;
-	return 1;
+	unsigned long flags;
+
+	spin_lock_irqsave(&rdev->q_lock, flags);
+	rdev->st.irqs++;
+	if (bounce)
+		rdev->st.bounces++;
+	spin_unlock_irqrestore(&rdev->q_lock, flags);
+}
+
+/* 엣지 간격으로 속도 갱신 (방향이 바뀌거나 오래 쉬면 0부터) */
+static void rotary_update_velocity(struct rotary_dev *rdev, ktime_t now, int dir)
+{
+	s64 dt_us = ktime_us_delta(now, rdev->last_rot_kt);
+	int inst;
+
+	rdev->last_rot_kt = now;
+
+	if (dir != rdev->last_rot_dir || dt_us <= 0 || dt_us > ROT_IDLE_MS * 1000) {
+		rdev->last_rot_dir = dir;
+		rdev->velocity = 0;
+		return;
+	}
+
+	inst = (int)div64_s64(1000000, dt_us);
+	rdev->velocity = (rdev->velocity * 3 + inst) / 4;
+}
+
+static int rotary_accel_step(struct rotary_dev *rdev, int step)
+{
+	int mult;
+
+	if (!accel || accel_min_vel <= 0)
+		return step;
+
+	mult = rdev->velocity / accel_min_vel;
+	if (mult < 1) mult = 1;
+	if (mult > accel_max) mult = accel_max;
+	return step * mult;
+}
+
+static enum hrtimer_restart rotary_long_timer_fn(struct hrtimer *t)
+{
+	struct rotary_dev *rdev = container_of(t, struct rotary_dev, long_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&rdev->gst_lock, flags);
+	if (rdev->key_down && !rdev->gst_consumed) {
+		rdev->gst_consumed = true;
+		q_push(rdev, EV_LONG, 1);
+	}
+	spin_unlock_irqrestore(&rdev->gst_lock, flags);
+	return HRTIMER_NORESTART;
+}
+
+static enum hrtimer_restart rotary_dbl_timer_fn(struct hrtimer *t)
+{
+	struct rotary_dev *rdev = container_of(t, struct rotary_dev, dbl_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&rdev->gst_lock, flags);
+	if (rdev->click_pending) {
+		rdev->click_pending = false;
+		q_push(rdev, EV_CLICK, 1);
+	}
+	spin_unlock_irqrestore(&rdev->gst_lock, flags);
+	return HRTIMER_NORESTART;
+}
+
+static void rotary_gesture_press(struct rotary_dev *rdev)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&rdev->gst_lock, flags);
+	rdev->key_press_kt = ktime_get();
+	rdev->gst_consumed = false;
+	hrtimer_start(&rdev->long_timer, ms_to_ktime(long_press_ms), HRTIMER_MODE_REL);
+	spin_unlock_irqrestore(&rdev->gst_lock, flags);
+}
+
+static void rotary_gesture_release(struct rotary_dev *rdev)
+{
+	unsigned long flags;
+	s64 held_ms;
+
+	spin_lock_irqsave(&rdev->gst_lock, flags);
+	hrtimer_try_to_cancel(&rdev->long_timer);
+	held_ms = ktime_ms_delta(ktime_get(), rdev->key_press_kt);
+
+	if (rdev->gst_consumed) {
+		/* long / press+rotate 로 이미 처리됨 */
+	} else if (held_ms >= long_press_ms) {
+		/* long_timer 콜백이 돌기 전에 떼어서 취소된 경우: 여기서 long 보고 */
+		rdev->gst_consumed = true;
+		q_push(rdev, EV_LONG, 1);
+	} else if (rdev->click_pending) {
+		hrtimer_try_to_cancel(&rdev->dbl_timer);
+		rdev->click_pending = false;
+		q_push(rdev, EV_DCLICK, 1);
+	} else {
+		rdev->click_pending = true;
+		hrtimer_start(&rdev->dbl_timer, ms_to_ktime(double_click_ms), HRTIMER_MODE_REL);
+	}
+	spin_unlock_irqrestore(&rdev->gst_lock, flags);
+}
+
+/* 누른 채 회전: long/click 판정 취소하고 press+rotate로 보고 */
+static void rotary_gesture_rotate(struct rotary_dev *rdev, int delta)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&rdev->gst_lock, flags);
+	if (rdev->key_down) {
+		if (!rdev->gst_consumed) {
+			rdev->gst_consumed = true;
+			hrtimer_try_to_cancel(&rdev->long_timer);
+		}
+		q_push(rdev, EV_PRESS_ROTATE, delta);
+	}
+	spin_unlock_irqrestore(&rdev->gst_lock, flags);
 }
 
 /* ===== ISR: S1 Falling에서 방향 판정(S2 레벨) ===== */
 static irqreturn_t rotary_s1_isr(int irq, void *dev_id)
 {
+	struct rotary_dev *rdev = dev_id;
 	unsigned long now = jiffies;
+	u64 t_ns = ktime_get_ns();
+	bool bounce = time_before(now, rdev->last_rot_j + msecs_to_jiffies(ROT_DEBOUNCE_MS));
 
-	if (time_before(now, last_rot_j + msecs_to_jiffies(ROT_DEBOUNCE_MS)))
+	rotary_count_irq(rdev, bounce);
+	if (bounce)
 		return IRQ_HANDLED;
-	last_rot_j = now;
+	rdev->last_rot_j = now;
 
 	/* 원본 로직 유지: S1 falling 시점의 S2로 방향 결정 */
 	{
-		int s2 = gpio_get_value(S2_GPIO);
+		int s2 = gpio_get_value(rdev->s2_gpio);
 		int step = (s2 == 1) ? +1 : -1;   /* 필요하면 여기 반대로 */
+		int delta;
 		if (invert_dir) step = -step;
 
-		rotary_value += step;
-		q_push(EV_ROTATE, step);
-		printk(KERN_INFO "rotary: S2=%d step=%d total=%ld\n", s2, step, rotary_value);
+		rotary_update_velocity(rdev, ktime_get(), step);
+		delta = rotary_accel_step(rdev, step);
+
+		rdev->value += delta;
+		q_push_ts(rdev, EV_ROTATE, delta, t_ns);
+		rotary_gesture_rotate(rdev, delta);
+
+		input_report_rel(rdev->input, input_wheel ? REL_WHEEL : REL_DIAL, step);
+		input_sync(rdev->input);
+		/* hardirq에서 detent마다 찍히므로 기본은 꺼짐 (dynamic debug로 켬) */
+		pr_debug("rotary%d: S2=%d step=%d delta=%d vel=%d total=%ld\n",
+		         rdev->index, s2, step, delta, rdev->velocity, rdev->value);
 
 	}
 
 	return IRQ_HANDLED;
 }
 
-/* ===== ISR: KEY (양엣지 받고, press만 필터) ===== */
-static irqreturn_t rotary_key_isr(int irq, void *dev_id)
+static int rotary_key_pressed(struct rotary_dev *rdev)
 {
-	unsigned long now = jiffies;
-	int level, pressed;
+	int level = gpio_get_value(rdev->key_gpio);
+	return key_active_low ? (level == 0) : (level == 1);
+}
 
-	if (time_before(now, last_key_j + msecs_to_jiffies(KEY_DEBOUNCE_MS)))
-		return IRQ_HANDLED;
-	last_key_j = now;
+/* 키 상태 변화 1건 처리: evdev엔 press/release 둘 다, /dev/rotaryN엔 press만 */
+static void rotary_key_edge(struct rotary_dev *rdev, int pressed, u64 t_ns)
+{
+	if (pressed == rdev->key_down)
+		return;
+	rdev->key_down = pressed;
 
-	level = gpio_get_value(KEY_GPIO);
-	pressed = key_active_low ? (level == 0) : (level == 1);
+	input_report_key(rdev->input, input_keycode, pressed);
+	input_sync(rdev->input);
 
-	if (!pressed)
-		return IRQ_HANDLED; /* release 무시 */
+	if (pressed) {
+		q_push_ts(rdev, EV_KEY, 1, t_ns);
+		rotary_gesture_press(rdev);
+	} else {
+		rotary_gesture_release(rdev);
+	}
+}
+
+/* 디바운스 창이 끝난 뒤 레벨을 다시 읽어서, 창 안에서 버려진 엣지
+   (짧은 클릭의 release 등)를 놓치지 않게 한다. */
+static void rotary_key_timer_fn(struct timer_list *t)
+{
+	struct rotary_dev *rdev = from_timer(rdev, t, key_timer);
+	unsigned long flags;
+	u64 t_ns;
+
+	local_irq_save(flags);
+	/* 창 안에서 들어온 첫 엣지 시각 -> 디바운스로 늦어진 만큼도 지연에 잡힘 */
+	t_ns = rdev->key_pend_ns ? rdev->key_pend_ns : ktime_get_ns();
+	rdev->key_pend_ns = 0;
+	rotary_key_edge(rdev, rotary_key_pressed(rdev), t_ns);
+	local_irq_restore(flags);
+}
+
+/* ===== ISR: KEY (양엣지 받음) ===== */
+static irqreturn_t rotary_key_isr(int irq, void *dev_id)
+{
+	struct rotary_dev *rdev = dev_id;
+	unsigned long now = jiffies;
+	u64 t_ns = ktime_get_ns();
+	bool bounce = time_before(now, rdev->last_key_j + msecs_to_jiffies(KEY_DEBOUNCE_MS));
+
+	rotary_count_irq(rdev, bounce);
+	if (bounce) {
+		if (!rdev->key_pend_ns)
+			rdev->key_pend_ns = t_ns;
+		mod_timer(&rdev->key_timer, rdev->last_key_j + msecs_to_jiffies(KEY_DEBOUNCE_MS) + 1);
+		return IRQ_HANDLED;
+	}
+	rdev->last_key_j = now;
+	rdev->key_pend_ns = 0;
 
-	q_push(EV_KEY, 1);
+	rotary_key_edge(rdev, rotary_key_pressed(rdev), t_ns);
 	return IRQ_HANDLED;
 }
 
 /* ===== read: 이벤트 1개를 텍스트로 전달 =====
-   ROTATE: "R +1 123\n" (delta, total)
+   ROTATE: "R +1 123 0\n" (delta, total, velocity detent/s)
+           delta는 가속/합치기 때문에 ±1보다 클 수 있음
    KEY:    "K\n"
+   제스처(마스크로 켠 경우만):
+           "G CLICK\n", "G DOUBLE\n", "G LONG\n",
+           "G TURN +1 123 0\n" (누른 채 회전, ROTATE와 같은 필드)
+   SET_MASK에 ROTARY_READ_STAMP를 켠 reader만 줄 끝(\n 앞)에 " @<ns>"가 붙음:
+   원인 엣지의 hardirq 시각, CLOCK_MONOTONIC ns. 예) "R +1 123 0 @81234567890\n"
 */
+static int rotary_open(struct inode *inode, struct file *file)
+{
+	struct rotary_dev *rdev = container_of(inode->i_cdev, struct rotary_dev, cdev);
+	struct rotary_reader *rd;
+	unsigned long flags;
+
+	rd = kzalloc(sizeof(*rd), GFP_KERNEL);
+	if (!rd)
+		return -ENOMEM;
+
+	rd->rdev = rdev;
+	rd->evmask = ROTARY_EVMASK_DEFAULT;
+
+	spin_lock_irqsave(&rdev->q_lock, flags);
+	list_add_tail(&rd->node, &rdev->readers);
+	spin_unlock_irqrestore(&rdev->q_lock, flags);
+
+	file->private_data = rd;
+	return 0;
+}
+
+static int rotary_release(struct inode *inode, struct file *file)
+{
+	struct rotary_reader *rd = file->private_data;
+	struct rotary_dev *rdev = rd->rdev;
+	unsigned long flags;
+
+	spin_lock_irqsave(&rdev->q_lock, flags);
+	list_del(&rd->node);
+	spin_unlock_irqrestore(&rdev->q_lock, flags);
+
+	kfree(rd);
+	return 0;
+}
+
 static ssize_t rotary_read(struct file *file, char __user *user_buff,
                            size_t count, loff_t *ppos)
 {
-	char buffer[64];
+	struct rotary_reader *rd = file->private_data;
+	char buffer[96];
 	int len;
 	struct rot_event ev;
 
-	if (wait_event_interruptible(rotary_wait_queue, !q_empty()))
+	if (q_empty(rd) && (file->f_flags & O_NONBLOCK))
+		return -EAGAIN;
+
+	if (wait_event_interruptible(rd->rdev->wait, !q_empty(rd)))
 		return -ERESTARTSYS;
 
-	if (!q_pop(&ev))
+	if (!q_pop(rd, &ev))
 		return 0;
 
-	if (ev.type == EV_KEY) {
+	switch (ev.type) {
+	case EV_KEY:
 		len = snprintf(buffer, sizeof(buffer), "K\n");
-	} else {
-		len = snprintf(buffer, sizeof(buffer), "R %d %ld\n", ev.value, rotary_value);
+		break;
+	case EV_CLICK:
+		len = snprintf(buffer, sizeof(buffer), "G CLICK\n");
+		break;
+	case EV_DCLICK:
+		len = snprintf(buffer, sizeof(buffer), "G DOUBLE\n");
+		break;
+	case EV_LONG:
+		len = snprintf(buffer, sizeof(buffer), "G LONG\n");
+		break;
+	case EV_PRESS_ROTATE:
+		len = snprintf(buffer, sizeof(buffer), "G TURN %d %ld %d\n",
+		               ev.value, ev.total, ev.velocity);
+		break;
+	default:
+		len = snprintf(buffer, sizeof(buffer), "R %d %ld %d\n",
+		               ev.value, ev.total, ev.velocity);
+		break;
 	}
 
+	rotary_lat_add(rd->rdev, ev.t_ns);
+	if (READ_ONCE(rd->evmask) & ROTARY_READ_STAMP)   /* 마지막 '\n' 자리부터 덮어씀 */
+		len = len - 1 + scnprintf(buffer + len - 1, sizeof(buffer) - len + 1,
+		                          " @%llu\n", ev.t_ns);
+
 	if (count < len)
 		return -EINVAL;
 
@@ -164,118 +625,377 @@ static ssize_t rotary_read(struct file *file, char __user *user_buff,
 
 static __poll_t rotary_poll(struct file *file, poll_table *wait)
 {
+	struct rotary_reader *rd = file->private_data;
 	__poll_t mask = 0;
-	poll_wait(file, &rotary_wait_queue, wait);
-	if (!q_empty())
+	poll_wait(file, &rd->rdev->wait, wait);
+	if (!q_empty(rd))
 		mask |= POLLIN | POLLRDNORM;
 	return mask;
 }
 
+static long rotary_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	struct rotary_reader *rd = file->private_data;
+	struct rotary_dev *rdev = rd->rdev;
+	struct rotary_stats st;
+	unsigned long flags;
+	u32 mask;
+
+	switch (cmd) {
+	case ROTARY_IOCTL_STATS:
+		spin_lock_irqsave(&rdev->q_lock, flags);
+		st.queued = q_count(rd);
+		st.events = rd->events;
+		st.drops  = rd->drops;
+		st.coalesced = rd->coalesced;
+		st.velocity  = rdev->velocity;
+		spin_unlock_irqrestore(&rdev->q_lock, flags);
+
+		if (copy_to_user((void __user *)arg, &st, sizeof(st)))
+			return -EFAULT;
+		return 0;
+
+	case ROTARY_IOCTL_RESET:
+		spin_lock_irqsave(&rdev->q_lock, flags);
+		rd->events = 0;
+		rd->drops  = 0;
+		rd->coalesced = 0;
+		spin_unlock_irqrestore(&rdev->q_lock, flags);
+		return 0;
+
+	case ROTARY_IOCTL_SET_MASK:
+		if (get_user(mask, (u32 __user *)arg))
+			return -EFAULT;
+		if (mask & ~(ROTARY_EVMASK_ALL | ROTARY_READ_STAMP))
+			return -EINVAL;
+
+		spin_lock_irqsave(&rdev->q_lock, flags);
+		rd->evmask = mask;
+		spin_unlock_irqrestore(&rdev->q_lock, flags);
+		return 0;
+	}
+	return -ENOTTY;
+}
+
+/* debugfs: /sys/kernel/debug/rotary/rotaryN_latency
+   IRQ 엣지 -> read() 까지 (디바운스 지연 + 큐 대기 + 깨어나는 시간). 아무 값이나 쓰면 0으로 */
+static int rotary_lat_show(struct seq_file *m, void *v)
+{
+	struct rotary_dev *rdev = m->private;
+	u32 hist[LAT_BUCKETS];
+	u64 max_ns;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&rdev->q_lock, flags);
+	memcpy(hist, rdev->lat_hist, sizeof(hist));
+	max_ns = rdev->lat_max_ns;
+	spin_unlock_irqrestore(&rdev->q_lock, flags);
+
+	seq_puts(m, "# irq->read latency, us\n");
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		if (!hist[i])
+			continue;
+		seq_printf(m, "< %8lu: %u\n", 1UL << i, hist[i]);
+	}
+	seq_printf(m, "max: %llu\n", div_u64(max_ns, NSEC_PER_USEC));
+	return 0;
+}
+
+static int rotary_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rotary_lat_show, inode->i_private);
+}
+
+static ssize_t rotary_lat_write(struct file *file, const char __user *buf,
+                                size_t count, loff_t *ppos)
+{
+	struct rotary_dev *rdev = ((struct seq_file *)file->private_data)->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&rdev->q_lock, flags);
+	memset(rdev->lat_hist, 0, sizeof(rdev->lat_hist));
+	rdev->lat_max_ns = 0;
+	spin_unlock_irqrestore(&rdev->q_lock, flags);
+	return count;
+}
+
+static const struct file_operations rotary_lat_fops = {
+	.owner   = THIS_MODULE,
+	.open    = rotary_lat_open,
+	.read    = seq_read,
+	.write   = rotary_lat_write,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+/* sysfs: 파일 하나에 값 하나 */
+#define ROTARY_STAT_ATTR(field)							\
+static ssize_t field##_show(struct device *dev, struct device_attribute *attr, char *buf)	\
+{										\
+	struct rotary_dev *rdev = dev_get_drvdata(dev);				\
+	unsigned long flags;							\
+	u64 v;									\
+	spin_lock_irqsave(&rdev->q_lock, flags);				\
+	v = rdev->st.field;							\
+	spin_unlock_irqrestore(&rdev->q_lock, flags);				\
+	return sysfs_emit(buf, "%llu\n", v);					\
+}										\
+static DEVICE_ATTR_RO(field)
+
+ROTARY_STAT_ATTR(irqs);
+ROTARY_STAT_ATTR(bounces);
+ROTARY_STAT_ATTR(events);
+ROTARY_STAT_ATTR(drops);
+ROTARY_STAT_ATTR(coalesced);
+ROTARY_STAT_ATTR(reads);
+ROTARY_STAT_ATTR(read_ns_total);
+
+static struct attribute *rotary_stats_attrs[] = {
+	&dev_attr_irqs.attr,
+	&dev_attr_bounces.attr,
+	&dev_attr_events.attr,
+	&dev_attr_drops.attr,
+	&dev_attr_coalesced.attr,
+	&dev_attr_reads.attr,
+	&dev_attr_read_ns_total.attr,
+	NULL,
+};
+static const struct attribute_group rotary_stats_group = {
+	.name  = "stats",
+	.attrs = rotary_stats_attrs,
+};
+static const struct attribute_group *rotary_groups[] = {
+	&rotary_stats_group,
+	NULL,
+};
+
 static struct file_operations fops = {
-	.owner = THIS_MODULE,
-	.read  = rotary_read,
-	.poll  = rotary_poll,
+	.owner          = THIS_MODULE,
+	.open           = rotary_open,
+	.release        = rotary_release,
+	.read           = rotary_read,
+	.poll           = rotary_poll,
+	.unlocked_ioctl = rotary_ioctl,
 };
 
-static int __init rotary_driver_init(void)
+static int rotary_input_init(struct rotary_dev *rdev)
 {
 	int ret;
 
-	printk(KERN_INFO "===== rotary initializing =====\n");
+	/* 범위 밖 키코드는 input core의 keybit 배열을 넘어 씀 */
+	if (input_keycode < 0 || input_keycode > KEY_MAX) {
+		printk(KERN_ERR "ERROR: input_keycode %d out of range (0..%d)\n",
+		       input_keycode, KEY_MAX);
+		return -EINVAL;
+	}
 
-	qh = qt = 0;
-	rotary_value = 0;
-	last_rot_j = 0;
-	last_key_j = 0;
+	rdev->input = input_allocate_device();
+	if (!rdev->input)
+		return -ENOMEM;
 
-	/* 1) alloc dev number */
-	ret = alloc_chrdev_region(&device_number, 0, 1, DRIVER_NAME);
-	if (ret < 0) {
-		printk(KERN_ERR "ERROR: alloc_chrdev_region\n");
-		return ret;
-	}
+	snprintf(rdev->phys, sizeof(rdev->phys), DRIVER_NAME "/input%d", rdev->index);
+	rdev->input->name = "rotary";
+	rdev->input->phys = rdev->phys;
+	rdev->input->id.bustype = BUS_HOST;
 
-	/* 2) cdev add */
-	cdev_init(&rotary_cdev, &fops);
-	ret = cdev_add(&rotary_cdev, device_number, 1);
-	if (ret < 0) {
-		printk(KERN_ERR "ERROR: cdev_add\n");
-		unregister_chrdev_region(device_number, 1);
-		return ret;
-	}
+	input_set_capability(rdev->input, EV_REL, input_wheel ? REL_WHEEL : REL_DIAL);
+	if (rdev->key_gpio >= 0)
+		input_set_capability(rdev->input, EV_KEY, input_keycode);
 
-	/* 3) class / device */
-	rotary_class = class_create(THIS_MODULE, CLASS_NAME);
-	if (IS_ERR(rotary_class)) {
-		ret = PTR_ERR(rotary_class);
-		cdev_del(&rotary_cdev);
-		unregister_chrdev_region(device_number, 1);
-		return ret;
+	ret = input_register_device(rdev->input);
+	if (ret) {
+		input_free_device(rdev->input);
+		rdev->input = NULL;
 	}
-	device_create(rotary_class, NULL, device_number, NULL, DEV_NAME); /* /dev/rotary */
+	return ret;
+}
+
+/* 엔코더 1개: GPIO -> input -> cdev/device -> IRQ 순서로 올림 */
+static int rotary_setup(struct rotary_dev *rdev)
+{
+	dev_t devt = MKDEV(MAJOR(device_number), rdev->index);
+	int ret;
 
-	/* 4) GPIO request */
-	ret = gpio_request(S1_GPIO, "rotary_s1");
-	if (ret) goto err_gpio;
-	ret = gpio_request(S2_GPIO, "rotary_s2");
+	rdev->last_rot_kt = ktime_get();
+	INIT_LIST_HEAD(&rdev->readers);
+	spin_lock_init(&rdev->q_lock);
+	init_waitqueue_head(&rdev->wait);
+	timer_setup(&rdev->key_timer, rotary_key_timer_fn, 0);
+
+	spin_lock_init(&rdev->gst_lock);
+	hrtimer_init(&rdev->long_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	rdev->long_timer.function = rotary_long_timer_fn;
+	hrtimer_init(&rdev->dbl_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	rdev->dbl_timer.function = rotary_dbl_timer_fn;
+
+	snprintf(rdev->name_s1,  sizeof(rdev->name_s1),  "rotary%d_s1",  rdev->index);
+	snprintf(rdev->name_key, sizeof(rdev->name_key), "rotary%d_key", rdev->index);
+
+	/* 1) GPIO request */
+	ret = gpio_request(rdev->s1_gpio, "rotary_s1");
+	if (ret) return ret;
+	ret = gpio_request(rdev->s2_gpio, "rotary_s2");
 	if (ret) goto err_gpio2;
-	ret = gpio_request(KEY_GPIO, "rotary_key");
-	if (ret) goto err_gpio3;
+	if (rdev->key_gpio >= 0) {
+		ret = gpio_request(rdev->key_gpio, "rotary_key");
+		if (ret) goto err_gpio3;
+		gpio_direction_input(rdev->key_gpio);
+	}
+
+	gpio_direction_input(rdev->s1_gpio);
+	gpio_direction_input(rdev->s2_gpio);
 
-	gpio_direction_input(S1_GPIO);
-	gpio_direction_input(S2_GPIO);
-	gpio_direction_input(KEY_GPIO);
+	/* 2) input device (/dev/input/eventX) - ISR보다 먼저 */
+	ret = rotary_input_init(rdev);
+	if (ret) goto err_input;
 
-	/* 5) IRQ */
-	irq_s1  = gpio_to_irq(S1_GPIO);
-	irq_key = gpio_to_irq(KEY_GPIO);
+	/* 3) cdev / device (/dev/rotaryN) */
+	cdev_init(&rdev->cdev, &fops);
+	rdev->cdev.owner = THIS_MODULE;
+	ret = cdev_add(&rdev->cdev, devt, 1);
+	if (ret < 0) goto err_cdev;
 
-	ret = request_irq(irq_s1, rotary_s1_isr, IRQF_TRIGGER_FALLING, "rotary_irq_s1", NULL);
+	rdev->dev = device_create_with_groups(rotary_class, NULL, devt, rdev, rotary_groups,
+	                                      DEV_NAME "%d", rdev->index);
+	if (IS_ERR(rdev->dev)) {
+		ret = PTR_ERR(rdev->dev);
+		goto err_device;
+	}
+
+	/* 4) IRQ */
+	rdev->irq_s1 = gpio_to_irq(rdev->s1_gpio);
+	ret = request_irq(rdev->irq_s1, rotary_s1_isr, IRQF_TRIGGER_FALLING,
+	                  rdev->name_s1, rdev);
 	if (ret) goto err_irq;
 
-	/* KEY는 rising/falling 둘 다 받고 press만 필터 */
-	ret = request_irq(irq_key, rotary_key_isr,
-	                  IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING,
-	                  "rotary_irq_key", NULL);
-	if (ret) goto err_irq2;
+	/* KEY는 rising/falling 둘 다 받음 */
+	if (rdev->key_gpio >= 0) {
+		rdev->irq_key = gpio_to_irq(rdev->key_gpio);
+		ret = request_irq(rdev->irq_key, rotary_key_isr,
+		                  IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING,
+		                  rdev->name_key, rdev);
+		if (ret) goto err_irq2;
+	}
+
+	/* debugfs는 없어도 동작에 지장 없음 -> 에러 무시 */
+	{
+		char name[24];
 
-	printk(KERN_INFO "rotary driver init success -> /dev/%s (S1=%d S2=%d KEY=%d)\n",
-	       DEV_NAME, S1_GPIO, S2_GPIO, KEY_GPIO);
+		snprintf(name, sizeof(name), DEV_NAME "%d_latency", rdev->index);
+		rdev->dbg = debugfs_create_file(name, 0644, rotary_dbg_root, rdev, &rotary_lat_fops);
+	}
+
+	printk(KERN_INFO "rotary driver init success -> /dev/%s%d (S1=%d S2=%d KEY=%d)\n",
+	       DEV_NAME, rdev->index, rdev->s1_gpio, rdev->s2_gpio, rdev->key_gpio);
 	return 0;
 
 err_irq2:
-	free_irq(irq_s1, NULL);
+	free_irq(rdev->irq_s1, rdev);
 err_irq:
-	gpio_free(KEY_GPIO);
+	device_destroy(rotary_class, devt);
+err_device:
+	cdev_del(&rdev->cdev);
+err_cdev:
+	input_unregister_device(rdev->input);
+err_input:
+	if (rdev->key_gpio >= 0)
+		gpio_free(rdev->key_gpio);
 err_gpio3:
-	gpio_free(S2_GPIO);
+	gpio_free(rdev->s2_gpio);
 err_gpio2:
-	gpio_free(S1_GPIO);
-err_gpio:
-	device_destroy(rotary_class, device_number);
+	gpio_free(rdev->s1_gpio);
+	return ret;
+}
+
+static void rotary_teardown(struct rotary_dev *rdev)
+{
+	debugfs_remove(rdev->dbg);
+	if (rdev->key_gpio >= 0)
+		free_irq(rdev->irq_key, rdev);
+	free_irq(rdev->irq_s1, rdev);
+	del_timer_sync(&rdev->key_timer);
+	hrtimer_cancel(&rdev->long_timer);
+	hrtimer_cancel(&rdev->dbl_timer);
+
+	device_destroy(rotary_class, MKDEV(MAJOR(device_number), rdev->index));
+	cdev_del(&rdev->cdev);
+
+	input_unregister_device(rdev->input);
+
+	if (rdev->key_gpio >= 0)
+		gpio_free(rdev->key_gpio);
+	gpio_free(rdev->s2_gpio);
+	gpio_free(rdev->s1_gpio);
+}
+
+static int __init rotary_driver_init(void)
+{
+	int ret, i;
+
+	printk(KERN_INFO "===== rotary initializing =====\n");
+
+	if (s1_num < 1 || s2_num != s1_num) {
+		printk(KERN_ERR "ERROR: s1_gpios/s2_gpios count mismatch (%d/%d)\n", s1_num, s2_num);
+		return -EINVAL;
+	}
+
+	/* 1) alloc dev number (엔코더 수만큼 minor) */
+	ret = alloc_chrdev_region(&device_number, 0, s1_num, DRIVER_NAME);
+	if (ret < 0) {
+		printk(KERN_ERR "ERROR: alloc_chrdev_region\n");
+		return ret;
+	}
+
+	/* 2) class */
+	rotary_class = class_create(THIS_MODULE, CLASS_NAME);
+	if (IS_ERR(rotary_class)) {
+		ret = PTR_ERR(rotary_class);
+		unregister_chrdev_region(device_number, s1_num);
+		return ret;
+	}
+
+	rotary_dbg_root = debugfs_create_dir(DEV_NAME, NULL);
+
+	/* 3) 엔코더별 인스턴스 */
+	for (i = 0; i < s1_num; i++) {
+		struct rotary_dev *rdev = &rotary_devs[i];
+
+		memset(rdev, 0, sizeof(*rdev));
+		rdev->index    = i;
+		rdev->s1_gpio  = s1_gpios[i];
+		rdev->s2_gpio  = s2_gpios[i];
+		rdev->key_gpio = (i < key_num) ? key_gpios[i] : -1;
+
+		ret = rotary_setup(rdev);
+		if (ret) {
+			printk(KERN_ERR "ERROR: rotary%d setup (%d)\n", i, ret);
+			goto err_setup;
+		}
+		rotary_count++;
+	}
+	return 0;
+
+err_setup:
+	while (rotary_count > 0)
+		rotary_teardown(&rotary_devs[--rotary_count]);
+	debugfs_remove_recursive(rotary_dbg_root);
 	class_destroy(rotary_class);
-	cdev_del(&rotary_cdev);
-	unregister_chrdev_region(device_number, 1);
+	unregister_chrdev_region(device_number, s1_num);
 	return ret;
 }
 
 static void __exit rotary_driver_exit(void)
 {
-	free_irq(irq_key, NULL);
-	free_irq(irq_s1, NULL);
+	while (rotary_count > 0)
+		rotary_teardown(&rotary_devs[--rotary_count]);
+	debugfs_remove_recursive(rotary_dbg_root);
 
-	gpio_free(KEY_GPIO);
-	gpio_free(S2_GPIO);
-	gpio_free(S1_GPIO);
-
-	device_destroy(rotary_class, device_number);
 	class_destroy(rotary_class);
-	cdev_del(&rotary_cdev);
-	unregister_chrdev_region(device_number, 1);
+	unregister_chrdev_region(device_number, s1_num);
 
 	printk(KERN_INFO "rotary_driver_exit\n");
 }
 
 module_init(rotary_driver_init);
 module_exit(rotary_driver_exit);
-
@@ -9,12 +9,38 @@
 #include <linux/delay.h>
 #include <linux/slab.h>
 #include <linux/string.h>
+#include <linux/ioctl.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/log2.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/device.h>
+#include <linux/sysfs.h>
 
 #define DEV_NAME "ssd1306"
 #define WIDTH  128
 #define HEIGHT 64
 #define FB_SZ  (WIDTH * HEIGHT / 8)
 
+/* ===== ioctl ===== */
+/* 부분 갱신: fb(유저 1024B 프레임) 중 page0..page1 x col0..col1 (양끝 포함) 만 전송 */
+#define SSD1306_IOCTL_MAGIC 'o'
+struct ssd1306_rect {
+	__u8  page0, page1;
+	__u8  col0, col1;
+	__u32 reserved;  /* 0이어야 함 (나중에 의미를 붙일 수 있게 지금부터 검사) */
+	__u64 fb;
+};
+#define SSD1306_IOCTL_UPDATE_RECT _IOW(SSD1306_IOCTL_MAGIC, 0x01, struct ssd1306_rect)
+/* 위와 같고, 이 프레임을 만든 입력 시각(CLOCK_MONOTONIC ns, rotary의 " @ns")을 같이 받아
+   마지막 page 전송이 끝난 시각까지를 debugfs latency 히스토그램에 넣음 */
+struct ssd1306_rect_ts {
+	struct ssd1306_rect rect;
+	__u64 t_input;   /* 0 = 측정 안 함 */
+};
+#define SSD1306_IOCTL_UPDATE_RECT_TS _IOW(SSD1306_IOCTL_MAGIC, 0x02, struct ssd1306_rect_ts)
+
 static int bus = 1;
 static int addr = 0x3c;
 module_param(bus, int, 0444);
@@ -24,10 +50,54 @@ static struct i2c_client *g_client;
 static u8 fb[FB_SZ];
 static DEFINE_MUTEX(oled_lock);
 
+/* 지연 히스토그램: 버킷 i = [2^(i-1), 2^i) us, 0 = 1us 미만. oled_lock으로 보호 */
+#define LAT_BUCKETS 24
+struct lat_hist {
+	u32 n[LAT_BUCKETS];
+	u64 max_ns;
+};
+static struct lat_hist lat_input;   /* 입력 엣지 -> 마지막 page 전송 완료 */
+static struct lat_hist lat_bus;     /* rect 전송 시작 -> 완료 (I2C만) */
+static struct dentry *dbg_root;
+
+/* sysfs 누적 카운터 (/sys/class/misc/ssd1306/stats/), oled_lock으로 보호 */
+static struct {
+	u64 frames_full;      /* 전체 1024B 전송 */
+	u64 frames_rect;      /* 부분 갱신 */
+	u64 bytes;            /* 패널로 보낸 데이터 바이트 (명령 제외) */
+	u64 errors;           /* i2c_master_send 실패 */
+	u64 flush_ns_total;   /* 프레임 전송 시간 합 / 최대 */
+	u64 flush_ns_max;
+} oled_stats;
+
+static void oled_stat_frame(u64 *frames, u64 ns)
+{
+	(*frames)++;
+	oled_stats.flush_ns_total += ns;
+	if (ns > oled_stats.flush_ns_max)
+		oled_stats.flush_ns_max = ns;
+}
+
+static void lat_hist_add(struct lat_hist *h, u64 d)
+{
+	u64 us = div_u64(d, NSEC_PER_USEC);
+	int b = us ? ilog2(us) + 1 : 0;
+
+	if (b >= LAT_BUCKETS)
+		b = LAT_BUCKETS - 1;
+	h->n[b]++;
+	if (d > h->max_ns)
+		h->max_ns = d;
+}
+
 static int ssd1306_cmd(u8 c)
 {
 	u8 buf[2] = {0x00, c}; /* 0x00 = command */
-	return i2c_master_send(g_client, buf, 2);
+	int ret = i2c_master_send(g_client, buf, 2);
+
+	if (ret < 0)
+		oled_stats.errors++;
+	return ret;
 }
 
 static int ssd1306_data(const u8 *data, size_t len)
@@ -45,7 +115,8 @@ static int ssd1306_data(const u8 *data, size_t len)
 		buf[0] = 0x40;
 		memcpy(&buf[1], &data[i], chunk);
 		ret = i2c_master_send(g_client, buf, 1 + chunk);
-		if (ret < 0) { kfree(buf); return ret; }
+		if (ret < 0) { oled_stats.errors++; kfree(buf); return ret; }
+		oled_stats.bytes += chunk;
 		i += chunk;
 	}
 
@@ -133,6 +204,11 @@ static int ssd1306_update(void)
 	ret = ssd1306_cmd(0x20); if (ret < 0) return ret; /* memory mode */
 	ret = ssd1306_cmd(0x00); if (ret < 0) return ret; /* horizontal */
 
+	/* 부분 갱신이 좁혀 둔 창을 전체로 되돌림 */
+	ret = ssd1306_cmd(0x21); ret |= ssd1306_cmd(0); ret |= ssd1306_cmd(WIDTH - 1);
+	ret |= ssd1306_cmd(0x22); ret |= ssd1306_cmd(0); ret |= ssd1306_cmd(7);
+	if (ret < 0) return ret;
+
 	for (p = 0; p < 8; p++) {
 		ret = ssd1306_cmd(0xB0 + p); if (ret < 0) return ret; /* page */
 		ret = ssd1306_cmd(0x00);     if (ret < 0) return ret; /* col low */
@@ -143,6 +219,23 @@ static int ssd1306_update(void)
 	return 0;
 }
 
+/* horizontal mode에서 column/page 창을 rect로 잡으면 데이터가 창 안에서 순서대로 채워짐 */
+static int ssd1306_update_rect(int p0, int p1, int c0, int c1)
+{
+	int p, ret;
+	int w = c1 - c0 + 1;
+
+	ret = ssd1306_cmd(0x21); ret |= ssd1306_cmd(c0); ret |= ssd1306_cmd(c1);
+	ret |= ssd1306_cmd(0x22); ret |= ssd1306_cmd(p0); ret |= ssd1306_cmd(p1);
+	if (ret < 0) return ret;
+
+	for (p = p0; p <= p1; p++) {
+		ret = ssd1306_data(&fb[p * WIDTH + c0], w);
+		if (ret < 0) return ret;
+	}
+	return 0;
+}
+
 static int ssd1306_init_panel(void)
 {
 	int ret;
@@ -169,6 +262,15 @@ static int ssd1306_init_panel(void)
 	return ssd1306_update();
 }
 
+/* oled_lock 잡은 상태에서 */
+static void oled_flush_full(void)
+{
+	u64 t0 = ktime_get_ns();
+
+	if (ssd1306_update() >= 0)
+		oled_stat_frame(&oled_stats.frames_full, ktime_get_ns() - t0);
+}
+
 static ssize_t oled_write(struct file *f, const char __user *ubuf, size_t cnt, loff_t *ppos)
 {
 	char *kbuf;
@@ -194,7 +296,7 @@ static ssize_t oled_write(struct file *f, const char __user *ubuf, size_t cnt, l
 
 	if (n == FB_SZ) {
 		memcpy(fb, kbuf, FB_SZ);
-		ssd1306_update();
+		oled_flush_full();
 		mutex_unlock(&oled_lock);
 		kfree(kbuf);
 		return cnt;
@@ -214,22 +316,160 @@ static ssize_t oled_write(struct file *f, const char __user *ubuf, size_t cnt, l
 	if (line2)
 		draw_text_line(0, 16, line2);
 
-	ssd1306_update();
+	oled_flush_full();
 
 	mutex_unlock(&oled_lock);
 	kfree(kbuf);
 	return cnt;
 }
 
+static long oled_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
+{
+	struct ssd1306_rect_ts rt = { .t_input = 0 };
+	struct ssd1306_rect r;
+	const u8 __user *ufb;
+	u64 t0, t1;
+	int p, w, ret;
+
+	switch (cmd) {
+	case SSD1306_IOCTL_UPDATE_RECT:
+		if (copy_from_user(&rt.rect, (void __user *)arg, sizeof(rt.rect)))
+			return -EFAULT;
+		break;
+	case SSD1306_IOCTL_UPDATE_RECT_TS:
+		if (copy_from_user(&rt, (void __user *)arg, sizeof(rt)))
+			return -EFAULT;
+		break;
+	default:
+		return -ENOTTY;
+	}
+	r = rt.rect;
+	if (r.reserved)
+		return -EINVAL;
+	if (r.page0 > r.page1 || r.page1 >= HEIGHT / 8 ||
+	    r.col0 > r.col1 || r.col1 >= WIDTH)
+		return -EINVAL;
+
+	ufb = u64_to_user_ptr(r.fb);
+	w = r.col1 - r.col0 + 1;
+
+	mutex_lock(&oled_lock);
+
+	/* rect 안쪽 바이트만 가져옴 */
+	for (p = r.page0; p <= r.page1; p++) {
+		int off = p * WIDTH + r.col0;
+		if (copy_from_user(&fb[off], ufb + off, w)) {
+			mutex_unlock(&oled_lock);
+			return -EFAULT;
+		}
+	}
+	t0 = ktime_get_ns();
+	ret = ssd1306_update_rect(r.page0, r.page1, r.col0, r.col1);
+	t1 = ktime_get_ns();
+
+	if (ret >= 0) {
+		oled_stat_frame(&oled_stats.frames_rect, t1 - t0);
+		lat_hist_add(&lat_bus, t1 - t0);
+		if (rt.t_input && rt.t_input <= t1)
+			lat_hist_add(&lat_input, t1 - rt.t_input);
+	}
+
+	mutex_unlock(&oled_lock);
+	return ret < 0 ? ret : 0;
+}
+
+/* debugfs: /sys/kernel/debug/ssd1306/{latency,bus}. 아무 값이나 쓰면 0으로 */
+static int lat_show(struct seq_file *m, void *v)
+{
+	struct lat_hist h;
+	int i;
+
+	mutex_lock(&oled_lock);
+	h = *(struct lat_hist *)m->private;
+	mutex_unlock(&oled_lock);
+
+	seq_printf(m, "# %s, us\n", m->private == &lat_input ? "input->flush latency" : "rect transfer time");
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		if (!h.n[i])
+			continue;
+		seq_printf(m, "< %8lu: %u\n", 1UL << i, h.n[i]);
+	}
+	seq_printf(m, "max: %llu\n", div_u64(h.max_ns, NSEC_PER_USEC));
+	return 0;
+}
+
+static int lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lat_show, inode->i_private);
+}
+
+static ssize_t lat_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct lat_hist *h = ((struct seq_file *)file->private_data)->private;
+
+	mutex_lock(&oled_lock);
+	memset(h, 0, sizeof(*h));
+	mutex_unlock(&oled_lock);
+	return count;
+}
+
+static const struct file_operations lat_fops = {
+	.owner   = THIS_MODULE,
+	.open    = lat_open,
+	.read    = seq_read,
+	.write   = lat_write,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
 static const struct file_operations oled_fops = {
-	.owner = THIS_MODULE,
-	.write = oled_write,
+	.owner          = THIS_MODULE,
+	.write          = oled_write,
+	.unlocked_ioctl = oled_ioctl,
+};
+
+/* 파일 하나에 값 하나: node exporter textfile 등에서 그대로 읽기 쉽게 */
+#define OLED_STAT_ATTR(field)							\
+static ssize_t field##_show(struct device *dev, struct device_attribute *attr, char *buf)	\
+{										\
+	u64 v;									\
+	mutex_lock(&oled_lock);							\
+	v = oled_stats.field;							\
+	mutex_unlock(&oled_lock);						\
+	return sysfs_emit(buf, "%llu\n", v);					\
+}										\
+static DEVICE_ATTR_RO(field)
+
+OLED_STAT_ATTR(frames_full);
+OLED_STAT_ATTR(frames_rect);
+OLED_STAT_ATTR(bytes);
+OLED_STAT_ATTR(errors);
+OLED_STAT_ATTR(flush_ns_total);
+OLED_STAT_ATTR(flush_ns_max);
+
+static struct attribute *oled_stats_attrs[] = {
+	&dev_attr_frames_full.attr,
+	&dev_attr_frames_rect.attr,
+	&dev_attr_bytes.attr,
+	&dev_attr_errors.attr,
+	&dev_attr_flush_ns_total.attr,
+	&dev_attr_flush_ns_max.attr,
+	NULL,
+};
+static const struct attribute_group oled_stats_group = {
+	.name  = "stats",
+	.attrs = oled_stats_attrs,
+};
+static const struct attribute_group *oled_groups[] = {
+	&oled_stats_group,
+	NULL,
 };
 
 static struct miscdevice oled_misc = {
-	.minor = MISC_DYNAMIC_MINOR,
-	.name  = DEV_NAME,
-	.fops  = &oled_fops,
+	.minor  = MISC_DYNAMIC_MINOR,
+	.name   = DEV_NAME,
+	.fops   = &oled_fops,
+	.groups = oled_groups,
 };
 
 static int __init oled_init(void)
@@ -263,12 +503,18 @@ static int __init oled_init(void)
 		return ret;
 	}
 
+	/* debugfs는 없어도 동작에 지장 없음 -> 에러 무시 */
+	dbg_root = debugfs_create_dir(DEV_NAME, NULL);
+	debugfs_create_file("latency", 0644, dbg_root, &lat_input, &lat_fops);
+	debugfs_create_file("bus", 0644, dbg_root, &lat_bus, &lat_fops);
+
 	pr_info("ssd1306 ready: /dev/%s (bus=%d addr=0x%x)\n", DEV_NAME, bus, addr);
 	return 0;
 }
 
 static void __exit oled_exit(void)
 {
+	debugfs_remove_recursive(dbg_root);
 	memset(fb, 0x00, sizeof(fb));
 	ssd1306_update();
 
@@ -7,8 +7,21 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <getopt.h>
+#include <glob.h>
+#include <dirent.h>
 #include <time.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <linux/rtc.h>
 
 #define OLED_W 128
@@ -24,15 +37,46 @@ static inline void set_px(int x,int y,int on){
   uint8_t m = (uint8_t)(1u << (y%8));
   if(on) fb[idx] |= m; else fb[idx] &= (uint8_t)~m;
 }
-static inline void invert_rect(int x,int y,int w,int h){
-  for(int yy=y; yy<y+h; yy++){
-    for(int xx=x; xx<x+w; xx++){
-      if(xx<0||xx>=OLED_W||yy<0||yy>=OLED_H) continue;
-      int idx = xx + (yy/8)*OLED_W;
-      fb[idx] ^= (uint8_t)(1u << (yy%8));
+// page 단위로 행 마스크 만들어서 column 방향으로 8바이트씩 clear/set/XOR
+enum { R_CLEAR=0, R_SET, R_XOR };
+static void rect_op(int x,int y,int w,int h,int op){
+  int x0 = x<0 ? 0 : x, x1 = (x+w > OLED_W) ? OLED_W : x+w;
+  int y0 = y<0 ? 0 : y, y1 = (y+h > OLED_H) ? OLED_H : y+h;
+  if(x0>=x1 || y0>=y1) return;
+
+  for(int p=y0/8; p<=(y1-1)/8; p++){
+    int r0 = (p*8 > y0) ? 0 : y0 - p*8;
+    int r1 = (p*8+8 < y1) ? 8 : y1 - p*8;
+    uint8_t m = (uint8_t)((0xFFu << r0) & (0xFFu >> (8 - r1)));
+    uint64_t m64 = 0x0101010101010101ull * m;
+    uint8_t *row = &fb[p*OLED_W];
+    int xx = x0;
+    for(; xx+8 <= x1; xx+=8){
+      uint64_t v;
+      memcpy(&v, row+xx, 8);
+      if(op==R_XOR) v ^= m64; else if(op==R_SET) v |= m64; else v &= ~m64;
+      memcpy(row+xx, &v, 8);
+    }
+    for(; xx<x1; xx++){
+      if(op==R_XOR) row[xx] ^= m; else if(op==R_SET) row[xx] |= m; else row[xx] &= (uint8_t)~m;
     }
   }
 }
+static inline void invert_rect(int x,int y,int w,int h){ rect_op(x,y,w,h,R_XOR); }
+static inline void fill_rect(int x,int y,int w,int h,int on){ rect_op(x,y,w,h,on?R_SET:R_CLEAR); }
+
+// damage: 마지막으로 프레임 넘긴 이후 다시 그린 영역(page/column 합집합). display는 이 안에서만 diff
+static int dmg_p0 = OLED_H/8, dmg_p1 = -1, dmg_c0 = OLED_W, dmg_c1 = -1;
+static void dmg_add(int x,int y,int w,int h){
+  int x0 = x<0 ? 0 : x, x1 = (x+w > OLED_W) ? OLED_W : x+w;
+  int y0 = y<0 ? 0 : y, y1 = (y+h > OLED_H) ? OLED_H : y+h;
+  if(x0>=x1 || y0>=y1) return;
+  if(y0/8 < dmg_p0) dmg_p0 = y0/8;
+  if((y1-1)/8 > dmg_p1) dmg_p1 = (y1-1)/8;
+  if(x0 < dmg_c0) dmg_c0 = x0;
+  if(x1-1 > dmg_c1) dmg_c1 = x1-1;
+}
+static void dmg_reset(void){ dmg_p0 = OLED_H/8; dmg_p1 = -1; dmg_c0 = OLED_W; dmg_c1 = -1; }
 
 typedef struct { char ch; uint8_t col[5]; } Glyph;
 static const Glyph font[] = {
@@ -71,22 +115,47 @@ static const Glyph font[] = {
   {'L',{0x7F,0x40,0x40,0x40,0x40}},
 };
 
-static const uint8_t* glyph(char c){
-  for(size_t i=0;i<sizeof(font)/sizeof(font[0]);i++)
-    if(font[i].ch==c) return font[i].col;
-  return font[0].col;
+#define NGLYPH    ((int)(sizeof(font)/sizeof(font[0])))
+#define MAX_SCALE 4
+
+// 문자 -> font[] index (없는 문자는 0 = ' ')
+static uint8_t glyph_idx[256];
+// scale별로 키운 column 비트맵 (7*scale <= 28 bit). 처음 쓰는 scale에서 한 번만 만듦
+static uint32_t gcache[MAX_SCALE+1][NGLYPH][5*MAX_SCALE];
+static uint8_t gcache_ok[MAX_SCALE+1];
+
+static void font_init(void){
+  memset(glyph_idx, 0, sizeof(glyph_idx));
+  for(int i=NGLYPH-1;i>=0;i--) glyph_idx[(uint8_t)font[i].ch] = (uint8_t)i;
 }
-static void draw_char(int x,int y,char c,int scale){
-  const uint8_t *g = glyph(c);
-  for(int col=0; col<5; col++){
-    uint8_t bits = g[col];
-    for(int row=0; row<7; row++){
-      if(((bits>>row)&1)==0) continue;
-      for(int sy=0; sy<scale; sy++)
-        for(int sx=0; sx<scale; sx++)
-          set_px(x + col*scale + sx, y + row*scale + sy, 1);
+static void gcache_build(int scale){
+  for(int g=0; g<NGLYPH; g++){
+    for(int col=0; col<5; col++){
+      uint32_t v = 0;
+      for(int row=0; row<7; row++)
+        if((font[g].col[col] >> row) & 1)
+          v |= ((1u << scale) - 1) << (row*scale);
+      for(int sx=0; sx<scale; sx++) gcache[scale][g][col*scale + sx] = v;
     }
   }
+  gcache_ok[scale] = 1;
+}
+
+// 한 column(세로 비트열)을 y 위치에 맞게 shift 해서 걸치는 page들에 바이트 단위 OR
+static inline void blit_col(int x, int y, uint64_t bits){
+  if(x<0 || x>=OLED_W) return;
+  if(y < 0){ if(y <= -32) return; bits >>= -y; y = 0; }
+  bits <<= (y & 7);
+  for(int p=y>>3; bits && p<OLED_H/8; p++, bits >>= 8)
+    fb[p*OLED_W + x] |= (uint8_t)bits;
+}
+static void draw_char(int x,int y,char c,int scale){
+  if(scale<1) scale=1;
+  if(scale>MAX_SCALE) scale=MAX_SCALE;
+  if(!gcache_ok[scale]) gcache_build(scale);
+  const uint32_t *cols = gcache[scale][glyph_idx[(uint8_t)c]];
+  for(int i=0; i<5*scale; i++)
+    if(cols[i]) blit_col(x+i, y, cols[i]);
 }
 static void draw_text(int x,int y,const char* s,int scale){
   int cx=x;
@@ -96,20 +165,160 @@ static void draw_text(int x,int y,const char* s,int scale){
     if(cx >= OLED_W) break;
   }
 }
-static int fb_flush(int fd){
-  ssize_t n = write(fd, fb, FB_SZ);
-  return (n == FB_SZ) ? 0 : -1;
+
+// -------- device handles --------
+// 데몬 수명 동안 열어두고, I/O 에러(모듈 재로드 등)면 닫았다가 다음 사용 때 다시 연다.
+// tag가 있는 장치는 다시 열 때 epoll에도 다시 등록 (close하면 epoll에서 자동으로 빠짐)
+enum { SRC_ROT=1, SRC_TICK, SRC_DHT, SRC_SIG };
+
+typedef struct {
+  const char *path;
+  int flags;
+  int tag;       // epoll tag, 0=등록 안 함
+  int fd;
+  int evented;   // epoll 등록 성공 (드라이버가 poll 지원)
+} DevFd;
+
+static DevFd dev_oled = { "/dev/ssd1306", O_WRONLY, 0,       -1, 0 };
+static DevFd dev_rot  = { "/dev/rotary",  O_RDONLY|O_NONBLOCK, SRC_ROT, -1, 0 };
+static DevFd dev_dht  = { "/dev/dht11",   O_RDONLY, SRC_DHT, -1, 0 };
+static DevFd dev_rtc  = { "/dev/rtc0",    O_RDWR,   0,       -1, 0 };
+static int g_ep = -1;
+
+static int ep_add(int ep, int fd, int tag){
+  struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)tag };
+  return epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+}
+static int dev_get(DevFd *d){
+  if(d->fd >= 0) return d->fd;
+  d->fd = open(d->path, d->flags | O_CLOEXEC);
+  if(d->fd >= 0 && d->tag && g_ep >= 0)
+    d->evented = (ep_add(g_ep, d->fd, d->tag) == 0);
+  return d->fd;
+}
+static void dev_drop(DevFd *d){
+  if(d->fd < 0) return;
+  int e = errno;
+  close(d->fd);
+  d->fd = -1;
+  d->evented = 0;
+  errno = e;
+}
+
+// -------- present (ssd1306_i2c.c의 SSD1306_IOCTL_UPDATE_RECT와 같은 정의) --------
+#define SSD1306_IOCTL_MAGIC 'o'
+struct ssd1306_rect {
+  uint8_t  page0, page1;
+  uint8_t  col0, col1;
+  uint32_t reserved;
+  uint64_t fb;
+};
+#define SSD1306_IOCTL_UPDATE_RECT _IOW(SSD1306_IOCTL_MAGIC, 0x01, struct ssd1306_rect)
+struct ssd1306_rect_ts {
+  struct ssd1306_rect rect;
+  uint64_t t_input;    // 입력 시각 -> 드라이버가 page 전송 끝난 시각까지 debugfs 히스토그램에
+};
+#define SSD1306_IOCTL_UPDATE_RECT_TS _IOW(SSD1306_IOCTL_MAGIC, 0x02, struct ssd1306_rect_ts)
+
+// render -> display로 넘기는 프레임: 전체 fb + 이 프레임에서 다시 그린 damage 영역
+typedef struct {
+  uint8_t  fb[FB_SZ];
+  uint32_t seq;
+  int p0, p1, c0, c1;
+  uint32_t in_id;      // 반영된 입력 (리플레이 ack / 지연 측정)
+  int64_t  in_ns;
+  int64_t  ready_ns;   // render 끝난 시각
+} Frame;
+
+// 단계별 카운터. 각 필드는 한 thread만 쓰고, main이 --metrics 쓸 때와 끝날 때 읽음
+static struct {
+  _Atomic uint64_t wakeups, events, fsm_ns;     // input/FSM
+  _Atomic uint64_t frames, render_ns, render_ns_max;   // render
+  _Atomic uint64_t presents, bytes, present_errors;    // display
+} stats;
+
+// 패널에 실제로 올라가 있는 프레임 (display thread 전용). 바뀐 page/column 범위만 보냄
+static uint8_t fb_last[FB_SZ];
+static int fb_last_valid = 0;
+static int no_rect_ioctl = 0;   // 옛 드라이버(ENOTTY) -> 전체 프레임 write
+static int no_ts_ioctl = 0;     // 입력 시각 없는 rect ioctl만 있는 드라이버
+
+// 주어진 영역 안에서 실제로 바뀐 곳을 감싸는 page/column 사각형. 없으면 0
+static int fb_diff_span(const uint8_t *cur, int rp0,int rp1,int rc0,int rc1,
+                        int *p0,int *p1,int *c0,int *c1){
+  *p0 = -1;
+  for(int p=rp0;p<=rp1;p++){
+    const uint8_t *a = &cur[p*OLED_W], *b = &fb_last[p*OLED_W];
+    if(!memcmp(a+rc0, b+rc0, rc1-rc0+1)) continue;
+    int l=rc0, r=rc1;
+    while(a[l]==b[l]) l++;
+    while(a[r]==b[r]) r--;
+    if(*p0 < 0){ *p0 = p; *c0 = l; *c1 = r; }
+    else { if(l < *c0) *c0 = l; if(r > *c1) *c1 = r; }
+    *p1 = p;
+  }
+  return *p0 >= 0;
+}
+
+// full=1이면 frame의 damage 대신 화면 전체에서 diff (중간 프레임을 건너뛴 경우)
+static int fb_present(const Frame *f, int full){
+  if(dev_oled.fd < 0) fb_last_valid = 0;   // 다시 여는 경우 패널 내용 모름 -> 전체 전송
+  int fd = dev_get(&dev_oled);
+  if(fd < 0) return -1;
+
+  int p0=0,p1=0,c0=0,c1=0;
+  if(fb_last_valid){
+    int ok = full ? fb_diff_span(f->fb, 0, OLED_H/8-1, 0, OLED_W-1, &p0,&p1,&c0,&c1)
+                  : fb_diff_span(f->fb, f->p0, f->p1, f->c0, f->c1, &p0,&p1,&c0,&c1);
+    if(!ok) return 0;   // 같은 프레임 -> 전송 생략
+  }
+
+  if(fb_last_valid && !no_rect_ioctl){
+    struct ssd1306_rect_ts rt;
+    struct ssd1306_rect *r = &rt.rect;
+    memset(&rt, 0, sizeof(rt));
+    r->page0 = (uint8_t)p0; r->page1 = (uint8_t)p1;
+    r->col0  = (uint8_t)c0; r->col1  = (uint8_t)c1;
+    r->fb    = (uint64_t)(uintptr_t)f->fb;
+    rt.t_input = (uint64_t)f->in_ns;
+    int rc = -1;
+    if(rt.t_input && !no_ts_ioctl){
+      rc = ioctl(fd, SSD1306_IOCTL_UPDATE_RECT_TS, &rt);
+      if(rc < 0 && errno == ENOTTY) no_ts_ioctl = 1;
+    }
+    if(rc < 0 && (!rt.t_input || no_ts_ioctl))
+      rc = ioctl(fd, SSD1306_IOCTL_UPDATE_RECT, r);
+    if(rc == 0){
+      for(int p=p0;p<=p1;p++)
+        memcpy(&fb_last[p*OLED_W+c0], &f->fb[p*OLED_W+c0], c1-c0+1);
+      stats.presents++;
+      stats.bytes += (uint64_t)(p1-p0+1)*(c1-c0+1);
+      return 0;
+    }
+    if(errno == ENOTTY) no_rect_ioctl = 1;
+    else { stats.present_errors++; dev_drop(&dev_oled); return -1; }
+  }
+
+  ssize_t n = write(fd, f->fb, FB_SZ);
+  if(n < 0) dev_drop(&dev_oled);
+  if(n != FB_SZ){ stats.present_errors++; fb_last_valid = 0; return -1; }
+  memcpy(fb_last, f->fb, FB_SZ);
+  fb_last_valid = 1;
+  stats.presents++;
+  stats.bytes += FB_SZ;
+  return 0;
 }
 
 // -------- RTC helpers --------
 static int rtc_read_raw(struct rtc_time *rt){
-  int fd = open("/dev/rtc0", O_RDONLY | O_CLOEXEC);
-  if(fd < 0) return -1;
-  int r = ioctl(fd, RTC_RD_TIME, rt);
-  int e = errno;
-  close(fd);
-  errno = e;
-  return r;
+  for(int attempt=0; attempt<2; attempt++){
+    int fd = dev_get(&dev_rtc);
+    if(fd < 0) return -1;
+    if(ioctl(fd, RTC_RD_TIME, rt) == 0) return 0;
+    if(errno == EINVAL) return -1;   // 칩 값이 이상한 것 -> fd 문제 아님
+    dev_drop(&dev_rtc);              // 한 번 다시 열어서 재시도
+  }
+  return -1;
 }
 
 static int rtc_sane(const struct rtc_time *rt){
@@ -135,7 +344,63 @@ static void rtc_from_system(struct rtc_time *rt){
   rt->tm_sec  = tmv.tm_sec;
 }
 
-static void rtc_add_seconds(struct rtc_time *rt, int sec){
+// RTC 필드(벽시계 그대로) <-> 초 단위 정수. 타임존/DST 안 거치는 순수 달력 계산이라
+// fallback tick에서 mktime/localtime 호출이 없음 (H. Hinnant days_from_civil)
+static int64_t days_from_civil(int y, int m, int d){
+  y -= (m <= 2);
+  int64_t era = (y >= 0 ? y : y - 399) / 400;
+  int yoe = (int)(y - era * 400);
+  int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int doe = yoe * 365 + yoe/4 - yoe/100 + doy;
+  return era * 146097 + doe - 719468;
+}
+static void civil_from_days(int64_t z, int *y, int *m, int *d){
+  z += 719468;
+  int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  int doe = (int)(z - era * 146097);
+  int yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+  int doy = doe - (365*yoe + yoe/4 - yoe/100);
+  int mp  = (5*doy + 2) / 153;
+  *d = doy - (153*mp + 2)/5 + 1;
+  *m = mp + (mp < 10 ? 3 : -9);
+  *y = (int)(yoe + era * 400) + (*m <= 2);
+}
+static int64_t rt_to_secs(const struct rtc_time *rt){
+  int64_t days = days_from_civil(rt->tm_year + 1900, rt->tm_mon + 1, rt->tm_mday);
+  return days*86400 + rt->tm_hour*3600 + rt->tm_min*60 + rt->tm_sec;
+}
+static void secs_to_rt(int64_t t, struct rtc_time *rt){
+  int64_t days = t / 86400, rem = t % 86400;
+  if(rem < 0){ rem += 86400; days--; }
+  int y, m, d;
+  civil_from_days(days, &y, &m, &d);
+  memset(rt, 0, sizeof(*rt));
+  rt->tm_year = y - 1900;
+  rt->tm_mon  = m - 1;
+  rt->tm_mday = d;
+  rt->tm_hour = (int)(rem / 3600);
+  rt->tm_min  = (int)(rem / 60 % 60);
+  rt->tm_sec  = (int)(rem % 60);
+}
+// system clock(CLOCK_REALTIME)을 RTC와 같은 벽시계 초 단위로
+static int64_t sys_wall_secs(struct rtc_time *rt_out){
+  struct timespec ts;
+  struct tm tmv;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  localtime_r(&ts.tv_sec, &tmv);
+  struct rtc_time rt;
+  memset(&rt, 0, sizeof(rt));
+  rt.tm_year = tmv.tm_year;
+  rt.tm_mon  = tmv.tm_mon;
+  rt.tm_mday = tmv.tm_mday;
+  rt.tm_hour = tmv.tm_hour;
+  rt.tm_min  = tmv.tm_min;
+  rt.tm_sec  = tmv.tm_sec;
+  if(rt_out) *rt_out = rt;
+  return rt_to_secs(&rt);
+}
+// 편집 UI 저장값(벽시계)을 system clock에도 반영
+static int sys_set_wall(const struct rtc_time *rt){
   struct tm tmv;
   memset(&tmv, 0, sizeof(tmv));
   tmv.tm_year = rt->tm_year;
@@ -144,74 +409,59 @@ static void rtc_add_seconds(struct rtc_time *rt, int sec){
   tmv.tm_hour = rt->tm_hour;
   tmv.tm_min  = rt->tm_min;
   tmv.tm_sec  = rt->tm_sec;
-
+  tmv.tm_isdst = -1;
   time_t t = mktime(&tmv);
-  if(t == (time_t)-1) return;
-
-  t += sec;
-  localtime_r(&t, &tmv);
-
-  rt->tm_year = tmv.tm_year;
-  rt->tm_mon  = tmv.tm_mon;
-  rt->tm_mday = tmv.tm_mday;
-  rt->tm_hour = tmv.tm_hour;
-  rt->tm_min  = tmv.tm_min;
-  rt->tm_sec  = tmv.tm_sec;
+  if(t == (time_t)-1) return -1;
+  struct timespec ts = { .tv_sec = t, .tv_nsec = 0 };
+  return clock_settime(CLOCK_REALTIME, &ts);
+}
+static int64_t mono_ns(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+static int64_t mono_ms(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec*1000 + ts.tv_nsec/1000000;
 }
 
 
 static int rtc_set_with_retry(const struct rtc_time *rt_new){
+  int reopened = 0;
   for(int i=0;i<20;i++){
-    int fd = open("/dev/rtc0", O_RDWR | O_CLOEXEC);
+    int fd = dev_get(&dev_rtc);
     if(fd >= 0){
-      int r = ioctl(fd, RTC_SET_TIME, rt_new);
-      int e = errno;
-      close(fd);
-      errno = e;
-      return r;
+      if(ioctl(fd, RTC_SET_TIME, rt_new) == 0) return 0;
+      if(errno == EINVAL || reopened++) return -1;
+      dev_drop(&dev_rtc);
+      continue;
     }
     usleep(100 * 1000);
   }
   return -1;
 }
 
-// -------- DHT (open/read/close; 너는 이미 OK라 했으니 유지) --------
-static int read_file_once(const char *path, char *buf, size_t cap){
-  int fd = open(path, O_RDONLY | O_CLOEXEC);
-  if(fd < 0) return -1;
-  int n = (int)read(fd, buf, cap-1);
-  int e = errno;
-  close(fd);
-  errno = e;
-  if(n <= 0) return -1;
-  buf[n] = 0;
-  return n;
-}
-static int parse_two_ints(const char *s, int *a, int *b){
-  int cnt=0, v[2]={0,0};
-  const char *p=s;
-  while(*p && cnt<2){
-    if((*p>='0' && *p<='9') || (*p=='-' && p[1]>='0' && p[1]<='9')){
-      char *end=NULL;
-      long x = strtol(p, &end, 10);
-      if(end && end!=p){
-        v[cnt++] = (int)x;
-        p = end;
-        continue;
-      }
-    }
-    p++;
-  }
-  if(cnt==2){ *a=v[0]; *b=v[1]; return 0; }
-  return -1;
-}
+// -------- DHT (dht11_ledbar.c의 DHT11_IOCTL_READ와 같은 정의) --------
+#define DHT11_IOCTL_MAGIC 'd'
+struct dht11_data {
+  uint8_t temp;
+  uint8_t humi;
+  uint8_t ok;   // 1=valid, 0=invalid
+};
+#define DHT11_IOCTL_READ _IOR(DHT11_IOCTL_MAGIC, 0x01, struct dht11_data)
+
 static int dht_read_now(int *temp, int *humi){
-  char buf[96];
-  if(read_file_once("/dev/dht11", buf, sizeof(buf)) < 0) return -1;
-  int a=0,b=0;
-  if(parse_two_ints(buf, &a, &b) == 0){
-    *temp = a; *humi = b;
-    return 0;
+  for(int attempt=0; attempt<2; attempt++){
+    int fd = dev_get(&dev_dht);
+    if(fd < 0) return -1;
+    struct dht11_data d;
+    if(ioctl(fd, DHT11_IOCTL_READ, &d) == 0){
+      if(!d.ok) return -1;
+      *temp = d.temp; *humi = d.humi;
+      return 0;
+    }
+    dev_drop(&dev_dht);
   }
   return -1;
 }
@@ -235,252 +485,1529 @@ static void clamp_hms(int *h,int *m,int *s){
   if(*s<0) *s=59; if(*s>59) *s=0;
 }
 
-static int read_rotary_event(int fd, int *is_key, int *delta){
+// 입력 이벤트 하나. 드라이버 줄 끝에 " #id @ns"가 붙어 있으면(시뮬레이션/리플레이) 같이 읽음
+enum { EVK_KEY=1, EVK_ROT, EVK_DHT };
+typedef struct {
+  int kind;
+  int delta;               // EVK_ROT
+  int temp, humi, ok;      // EVK_DHT (리플레이)
+  uint32_t id;             // 리플레이 closed-loop ack 번호, 없으면 0
+  int64_t stamp_ns;        // 이벤트 발생 시각 (CLOCK_MONOTONIC), 없으면 0
+} InEv;
+
+// 1=event, 0=무시할 내용, -1=read 에러(errno), -2=EOF(시뮬레이션 스크립트 끝)
+static int read_rotary_event(int fd, InEv *ev){
   char buf[128];
   int n = (int)read(fd, buf, sizeof(buf)-1);
-  if(n<=0) return 0;
+  if(n<0) return -1;
+  if(n==0) return -2;
   buf[n]=0;
 
-  if(strchr(buf,'K')){ *is_key=1; *delta=0; return 1; }
+  memset(ev, 0, sizeof(*ev));
+  char *q;
+  if((q = strchr(buf,'#'))) ev->id = (uint32_t)strtoul(q+1, NULL, 10);
+  if((q = strchr(buf,'@'))) ev->stamp_ns = strtoll(q+1, NULL, 10);
+
+  if(buf[0]=='D'){
+    if(sscanf(buf,"D %d %d %d",&ev->temp,&ev->humi,&ev->ok)==3){ ev->kind=EVK_DHT; return 1; }
+    return 0;
+  }
+
+  if(strchr(buf,'K')){ ev->kind=EVK_KEY; return 1; }
 
   if(buf[0]=='R'){
     int d=0; long t=0;
-    if(sscanf(buf,"R %d %ld",&d,&t)>=1){ *is_key=0; *delta=d; return 1; }
+    if(sscanf(buf,"R %d %ld",&d,&t)>=1){ ev->kind=EVK_ROT; ev->delta=d; return 1; }
   }
 
   char *p = strstr(buf,"step=");
   if(p){
     int d=0;
-    if(sscanf(p,"step=%d",&d)==1){ *is_key=0; *delta=d; return 1; }
+    if(sscanf(p,"step=%d",&d)==1){ ev->kind=EVK_ROT; ev->delta=d; return 1; }
   }
   return 0;
 }
 
-enum Page { PAGE_CLOCK=0, PAGE_SENSOR=1 };
+enum Page { PAGE_CLOCK=0, PAGE_SENSOR=1, PAGE_GRAPH=2, PAGE_N };
 enum Field { F_YEAR=0, F_MON, F_DAY, F_HOUR, F_MIN, F_SEC, F_EXIT };
 
-static void render_clock_view(const struct rtc_time *rt, const char *toast){
-  char date[32], time_s[32];
-  int Y=rt->tm_year+1900, M=rt->tm_mon+1, D=rt->tm_mday;
-  int h=rt->tm_hour, m=rt->tm_min, s=rt->tm_sec;
+// -------- widgets (retained) --------
+// 위젯마다 bounds와 지금 그려진 값을 들고 있고, 값/표시가 바뀐 위젯만 bounds를 지우고 다시 그림.
+// 다시 그린 bounds는 damage로 모여서 display thread가 그 안에서만 비교/전송
+enum WKind { W_LABEL=0, W_GAUGE, W_SPARK };
 
-  snprintf(date,sizeof(date),"%04d-%02d-%02d",Y,M,D);
-  snprintf(time_s,sizeof(time_s),"%02d:%02d:%02d",h,m,s);
+// sparkline: 픽셀 열마다 세로 구간 [lo,hi] (위=0). lo > hi 면 빈 열
+#define SPARK_W 128
+typedef struct { uint8_t lo[SPARK_W], hi[SPARK_W]; } Spark;
 
-  fb_clear();
-  draw_text(0, 0, date, 1);
-  draw_text(0, 16, time_s, 2);
-  draw_text(0, 52, toast ? toast : "K:EDIT  R:PAGE", 1);
+typedef struct {
+  uint8_t kind;
+  uint8_t scale;
+  uint8_t hl;        // highlight box (bounds 반전)
+  uint8_t visible;
+  uint8_t dirty;
+  int16_t x, y, w, h;
+  char text[32];     // W_LABEL
+  int value;         // W_GAUGE 0..100
+  Spark *spark;      // W_SPARK (그려진 내용 보관)
+} Widget;
+
+#define LABEL(X,Y,W,H,S,T) { .kind=W_LABEL, .scale=S, .visible=1, .x=X, .y=Y, .w=W, .h=H, .text=T }
+#define GAUGE(X,Y,W,H)     { .kind=W_GAUGE, .visible=1, .x=X, .y=Y, .w=W, .h=H }
+#define SPARK(X,Y,W,H,B)   { .kind=W_SPARK, .visible=1, .x=X, .y=Y, .w=W, .h=H, .spark=B }
+
+static Widget *ui_cur;
+static int ui_cur_n;
+
+static void w_set_text(Widget *w, const char *t){
+  if(strncmp(w->text, t, sizeof(w->text)-1) == 0) return;
+  snprintf(w->text, sizeof(w->text), "%s", t);
+  w->dirty = 1;
+}
+static void w_set_value(Widget *w, int v){
+  if(v < 0) v = 0;
+  if(v > 100) v = 100;
+  if(w->value != v){ w->value = v; w->dirty = 1; }
+}
+static void w_set_spark(Widget *w, const Spark *sp){
+  if(memcmp(w->spark, sp, sizeof(*sp)) == 0) return;
+  *w->spark = *sp;
+  w->dirty = 1;
+}
+static void w_set_hl(Widget *w, int on){
+  if(w->hl != !!on){ w->hl = !!on; w->dirty = 1; }
+}
+static void w_set_visible(Widget *w, int on){
+  if(w->visible != !!on){ w->visible = !!on; w->dirty = 1; }
+}
+
+static void w_draw(const Widget *w){
+  switch(w->kind){
+    case W_LABEL:
+      draw_text(w->x, w->y, w->text, w->scale);
+      break;
+    case W_GAUGE: {
+      // 세로 막대: 테두리 + 아래에서부터 채움 (LED bar와 같은 방향)
+      fill_rect(w->x, w->y, w->w, 1, 1);
+      fill_rect(w->x, w->y+w->h-1, w->w, 1, 1);
+      fill_rect(w->x, w->y, 1, w->h, 1);
+      fill_rect(w->x+w->w-1, w->y, 1, w->h, 1);
+      int fh = (w->h - 4) * w->value / 100;
+      fill_rect(w->x+2, w->y+w->h-2-fh, w->w-4, fh, 1);
+      break;
+    }
+    case W_SPARK:
+      for(int i=0;i<w->w && i<SPARK_W;i++){
+        const Spark *sp = w->spark;
+        if(sp->lo[i] <= sp->hi[i]) fill_rect(w->x+i, w->y+sp->lo[i], 1, sp->hi[i]-sp->lo[i]+1, 1);
+      }
+      break;
+  }
+  if(w->hl) invert_rect(w->x, w->y, w->w, w->h);
 }
 
-static void render_clock_edit(int y,int mo,int d,int h,int mi,int s, enum Field f){
-  char date[32], time_s[32];
-  snprintf(date,sizeof(date),"%04d-%02d-%02d",y,mo,d);
-  snprintf(time_s,sizeof(time_s),"%02d:%02d:%02d",h,mi,s);
+static int w_overlap(const Widget *a, const Widget *b){
+  return a->x < b->x+b->w && b->x < a->x+a->w && a->y < b->y+b->h && b->y < a->y+a->h;
+}
 
+// 페이지 전환: 화면 전체를 새 위젯 목록으로
+static void ui_show(Widget *ws, int n){
+  if(ui_cur == ws) return;
+  ui_cur = ws;
+  ui_cur_n = n;
   fb_clear();
-  draw_text(0, 0, date, 1);
-  draw_text(0, 16, time_s, 2);
+  for(int i=0;i<n;i++) ws[i].dirty = 1;
+  dmg_add(0, 0, OLED_W, OLED_H);
+}
 
-  if(f==F_YEAR) invert_rect(0,0, 24, 9);
-  if(f==F_MON)  invert_rect(30,0, 12, 9);
-  if(f==F_DAY)  invert_rect(48,0, 12, 9);
+static void ui_render(void){
+  Widget *ws = ui_cur;
+  int n = ui_cur_n, more = 1;
 
-  if(f==F_HOUR) invert_rect(0,16, 24, 18);
-  if(f==F_MIN)  invert_rect(36,16, 24, 18);
-  if(f==F_SEC)  invert_rect(72,16, 24, 18);
+  // 지우는 영역에 걸친 위젯도 같이 다시 그려야 함
+  while(more){
+    more = 0;
+    for(int i=0;i<n;i++){
+      if(!ws[i].dirty) continue;
+      for(int j=0;j<n;j++)
+        if(!ws[j].dirty && ws[j].visible && w_overlap(&ws[i], &ws[j])){ ws[j].dirty = 1; more = 1; }
+    }
+  }
+  for(int i=0;i<n;i++){
+    if(!ws[i].dirty) continue;
+    fill_rect(ws[i].x, ws[i].y, ws[i].w, ws[i].h, 0);
+    dmg_add(ws[i].x, ws[i].y, ws[i].w, ws[i].h);
+  }
+  for(int i=0;i<n;i++){
+    if(ws[i].dirty && ws[i].visible) w_draw(&ws[i]);
+    ws[i].dirty = 0;
+  }
+}
 
-  if(f==F_EXIT){
-    draw_text(0, 52, "EXIT", 2);
-    invert_rect(0,52, 48, 18);
-    draw_text(54, 52, "K:SAVE", 1);
-  } else {
-    draw_text(0, 52, "K:NEXT  R:CHANGE", 1);
+// -------- options --------
+enum ClockSrc { CLK_RTC=0, CLK_SYS=1 };
+static enum ClockSrc opt_clock = CLK_RTC;
+static int opt_resync_s = 600;
+static int opt_sim = 0;
+static const char *opt_sim_script = NULL;
+static const char *opt_sim_out = NULL;
+static const char *opt_record = NULL;
+static const char *opt_replay = NULL;
+static int opt_speed = 1;           // 리플레이: 1=기록된 속도, N=N배속, 0=최대 속도(closed-loop)
+static int opt_real_display = 0;    // 리플레이를 실제 패널로
+static const char *opt_lat_stats = NULL;   // 단계별 지연 히스토그램 파일 (10초마다 갱신)
+static const char *opt_history = NULL;     // 센서 기록 ring 파일 (없으면 메모리에만)
+static const char *opt_metrics = NULL;     // Prometheus textfile (10초마다 갱신)
+
+static void usage(const char *argv0){
+  fprintf(stderr,
+    "usage: %s [--clock=rtc|sys] [--resync=SEC] [--sim [--sim-script=FILE] [--sim-out=DIR]]\n"
+    "  --clock=rtc   read /dev/rtc0 every loop (default)\n"
+    "  --clock=sys   render from CLOCK_REALTIME, read RTC only at start and every --resync sec\n"
+    "  --resync=SEC  RTC drift check period in sys mode (default 600)\n"
+    "  --sim         run without devices: scripted knob, fake DHT/RTC, frames to stdout\n"
+    "  --sim-script=FILE  knob script (K | R <delta> | W <ms> per line), default built-in\n"
+    "  --sim-out=DIR      write each frame as DIR/frame_NNNNNN.pbm instead of CRC lines\n"
+    "  --record=FILE      log knob events and DHT values (binary) while running\n"
+    "  --replay=FILE      replay a --record log through the UI, then print a latency report\n"
+    "  --speed=N          replay speed: 1=as recorded (default), N=N times, 0=as fast as possible\n"
+    "  --real-display     replay onto /dev/ssd1306 instead of the simulated panel\n"
+    "  --latency-stats=FILE  write per-stage input latency histograms to FILE every 10 s\n"
+    "  --history=FILE     keep 1m/1h/1d DHT min/max/avg buckets in FILE (mmap, <=1 write/min)\n"
+    "  --metrics=FILE     write driver + daemon counters as a Prometheus textfile every 10 s\n", argv0);
+}
+static int parse_args(int argc, char **argv){
+  static const struct option lo[] = {
+    {"clock",      required_argument, 0, 'c'},
+    {"resync",     required_argument, 0, 'r'},
+    {"sim",        no_argument,       0, 'S'},
+    {"sim-script", required_argument, 0, 's'},
+    {"sim-out",    required_argument, 0, 'o'},
+    {"record",     required_argument, 0, 'R'},
+    {"replay",     required_argument, 0, 'P'},
+    {"speed",      required_argument, 0, 'x'},
+    {"real-display", no_argument,     0, 'D'},
+    {"latency-stats", required_argument, 0, 'L'},
+    {"history",    required_argument, 0, 'H'},
+    {"metrics",    required_argument, 0, 'M'},
+    {"help",       no_argument,       0, 'h'},
+    {0,0,0,0}
+  };
+  int c;
+  while((c = getopt_long(argc, argv, "c:r:h", lo, NULL)) != -1){
+    switch(c){
+      case 'c':
+        if(!strcmp(optarg,"rtc")) opt_clock = CLK_RTC;
+        else if(!strcmp(optarg,"sys")) opt_clock = CLK_SYS;
+        else { usage(argv[0]); return -1; }
+        break;
+      case 'r':
+        opt_resync_s = atoi(optarg);
+        if(opt_resync_s < 10) opt_resync_s = 10;
+        break;
+      case 'S': opt_sim = 1; break;
+      case 's': opt_sim_script = optarg; break;
+      case 'o': opt_sim_out = optarg; break;
+      case 'R': opt_record = optarg; break;
+      case 'P': opt_replay = optarg; break;
+      case 'x': opt_speed = atoi(optarg); if(opt_speed < 0) opt_speed = 0; break;
+      case 'D': opt_real_display = 1; break;
+      case 'L': opt_lat_stats = optarg; break;
+      case 'H': opt_history = optarg; break;
+      case 'M': opt_metrics = optarg; break;
+      default:
+        usage(argv[0]);
+        return -1;
+    }
   }
+  if((opt_sim || opt_replay) && opt_clock == CLK_SYS){
+    fprintf(stderr, "env-oled: --sim/--replay use the fake RTC, ignoring --clock=sys\n");
+    opt_clock = CLK_RTC;
+  }
+  return 0;
 }
 
-static void render_sensor_big(int temp,int humi,int ok){
-  fb_clear();
-  if(!ok){
-    draw_text(0, 0, "DHT ERR", 2);
-    draw_text(0, 28, "R:PAGE  K:CLOCK", 1);
-    return;
+// -------- backend --------
+// FSM/렌더러 아래 장치 계층. real = /dev/*, sim = 호스트에서 돌리는 가짜 장치들
+typedef struct {
+  const char *name;
+  int (*init)(void);                        // epoll 만든 뒤, rotary fd 등록까지
+  int (*rot_reopen)(void);                  // tick: rotary가 에러로 닫혀 있으면
+  int (*rtc_read)(struct rtc_time *rt);
+  int (*rtc_set)(const struct rtc_time *rt);
+  int (*dht_read)(int *temp, int *humi);
+  int (*present)(const Frame *f, int full); // display thread
+  int eof_quits;                            // rotary EOF = 입력 끝 -> 종료
+} Backend;
+
+// rotary_device_driver.c의 SET_MASK와 같은 정의. ROTATE|KEY + 줄 끝 " @<irq ns>" (지연 측정용)
+#define ROTARY_IOCTL_SET_MASK _IOW('r', 0x03, uint32_t)
+#define ROTARY_MASK (1u<<0 | 1u<<1 | 1u<<31)
+
+// 열 때마다 stamp를 켬 (안 되는 옛 드라이버면 시각 없이 동작)
+static int rot_open(void){
+  int new_fd = dev_rot.fd < 0;
+  if(dev_get(&dev_rot) < 0) return -1;
+  uint32_t mask = ROTARY_MASK;
+  if(new_fd) (void)ioctl(dev_rot.fd, ROTARY_IOCTL_SET_MASK, &mask);
+  return dev_rot.fd;
+}
+static int real_init(void){
+  if(dev_get(&dev_oled)<0){ perror("open /dev/ssd1306"); return -1; }
+  if(rot_open()<0)        { perror("open /dev/rotary");  return -1; }
+  if(!dev_rot.evented)    { perror("epoll /dev/rotary"); return -1; }
+  return 0;
+}
+static int real_rot_reopen(void){ return rot_open(); }
+
+static const Backend be_real = {
+  "real", real_init, real_rot_reopen,
+  rtc_read_raw, rtc_set_with_retry, dht_read_now, fb_present, 0,
+};
+
+// sim: rotary = SEQPACKET socketpair (메시지 1개 = 드라이버 read 1번과 같은 경계),
+// 스크립트 thread가 반대쪽에 "K\n" / "R d 0 0\n"을 씀. 스크립트 끝 -> EOF -> 종료
+static struct {
+  int sock[2];
+  pthread_t feeder;
+  int64_t rtc_secs, rtc_mono;   // 가짜 RTC: 2025-01-01 00:00:00부터 monotonic으로 흐름
+  unsigned dht_n;
+  uint8_t last[FB_SZ];          // 가짜 패널
+  int last_valid;
+  uint32_t nframe;
+} sim;
+
+static const char sim_default_script[] =
+  "# 페이지 넘기기 -> 시계 편집(필드마다 돌리기) -> 저장 -> toast 만료까지\n"
+  "W 300\nR 1\nW 1500\nR -1\nW 300\n"
+  "K\nR 3\nK\nR -2\nK\nR 40\nK\nR 1\nK\nR -75\nK\nR 5\nK\n"
+  "W 300\nK\nW 2500\n";
+
+static void *sim_feeder(void *arg){
+  (void)arg;
+  FILE *fp = opt_sim_script ? fopen(opt_sim_script, "r")
+                            : fmemopen((void *)sim_default_script, strlen(sim_default_script), "r");
+  if(!fp){ perror(opt_sim_script); goto out; }
+
+  char line[128], msg[64];
+  while(fgets(line, sizeof(line), fp)){
+    char *p = line;
+    int v = 0, n = -1;
+    while(*p==' ' || *p=='\t') p++;
+    if(*p=='#' || *p=='\n' || *p==0) continue;
+    if(*p=='K')                                  n = snprintf(msg, sizeof(msg), "K @%lld\n", (long long)mono_ns());
+    else if(*p=='R' && sscanf(p+1, "%d", &v)==1) n = snprintf(msg, sizeof(msg), "R %d 0 0 @%lld\n", v, (long long)mono_ns());
+    else if(*p=='W' && sscanf(p+1, "%d", &v)==1){ usleep((useconds_t)v*1000); continue; }
+    else { fprintf(stderr, "sim: bad script line: %s", line); continue; }
+    if(send(sim.sock[1], msg, (size_t)n, MSG_NOSIGNAL) < 0) break;
   }
-  char hbuf[16], tbuf[16];
-  snprintf(hbuf,sizeof(hbuf),"%02d%%", humi);
-  snprintf(tbuf,sizeof(tbuf),"%02dC", temp);
-
-  draw_text(0, 0,  "HUMI", 1);
-  draw_text(0, 10, hbuf, 3);
-  draw_text(0, 38, "TEMP", 1);
-  draw_text(0, 48, tbuf, 2);
-}
-
-int main(void){
-  int fd_oled = open("/dev/ssd1306", O_WRONLY|O_CLOEXEC);
-  int fd_rot  = open("/dev/rotary",  O_RDONLY|O_CLOEXEC);
-  if(fd_oled<0){ perror("open /dev/ssd1306"); return 1; }
-  if(fd_rot <0){ perror("open /dev/rotary");  return 1; }
-
-  enum Page page = PAGE_CLOCK;
-  int edit = 0;
-  enum Field field = F_YEAR;
-
-  // last good rtc cache
-  struct rtc_time rt={0};
-  struct rtc_time rt_good={0};
-  int have_good = 0;
-
-  // edit buffer
-  int ey=2025, emo=1, ed=1, eh=0, emin=0, es=0;
-
-  // sensor
-  int temp=0, humi=0, dht_ok=0;
-
-  // toast
-  char toast[32]={0};
-  int toast_ticks=0;
-
-  // fallback tick (RTC read fail 시에도 화면 시간이 멈추지 않게)
-  struct timespec mono_prev;
-  clock_gettime(CLOCK_MONOTONIC, &mono_prev);
-  long acc_ms = 0;
-
-  while(1){
-    struct pollfd pfd={.fd=fd_rot,.events=POLLIN};
-    int pr = poll(&pfd,1,200);    // RTC read + sanity (RTC 실패 시 NTP(system time)로 덮지 말고, 마지막 값에서 tick)
-    struct timespec mono_now;
-    clock_gettime(CLOCK_MONOTONIC, &mono_now);
-    long dms = (mono_now.tv_sec - mono_prev.tv_sec)*1000L +
-               (mono_now.tv_nsec - mono_prev.tv_nsec)/1000000L;
-    if(dms < 0) dms = 0;
-    if(dms > 5000) dms = 5000;
-    mono_prev = mono_now;
-    acc_ms += dms;
-
-    if(rtc_read_raw(&rt)==0 && rtc_sane(&rt)){
-      rt_good = rt;
-      have_good = 1;
-      acc_ms = 0; // RTC로 동기화됐으니 tick 누적 초기화
-    } else {
-      if(!have_good){
-        // 첫 초기화만 system time 사용
-        rtc_from_system(&rt_good);
-        have_good = 1;
-        acc_ms = 0;
-      } else {
-        // 마지막 good 값에서 계속 진행 (NTP로 덮어쓰지 않음)
-        while(acc_ms >= 1000){
-          rtc_add_seconds(&rt_good, 1);
-          acc_ms -= 1000;
-        }
+  fclose(fp);
+out:
+  shutdown(sim.sock[1], SHUT_WR);
+  return NULL;
+}
+
+static int sim_start(void *(*feeder)(void *), int64_t rtc_secs){
+  if(socketpair(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0, sim.sock) < 0){ perror("socketpair"); return -1; }
+  fcntl(sim.sock[0], F_SETFL, O_NONBLOCK);
+  dev_rot.fd = sim.sock[0];
+  dev_rot.evented = (ep_add(g_ep, dev_rot.fd, SRC_ROT) == 0);
+
+  sim.rtc_secs = rtc_secs;
+  sim.rtc_mono = mono_ms();
+
+  if(pthread_create(&sim.feeder, NULL, feeder, NULL)){ fprintf(stderr, "sim: pthread_create failed\n"); return -1; }
+  return 0;
+}
+static int sim_init(void){
+  struct rtc_time rt;
+  memset(&rt, 0, sizeof(rt));
+  rt.tm_year = 2025 - 1900; rt.tm_mday = 1;
+  return sim_start(sim_feeder, rt_to_secs(&rt));
+}
+static int sim_rot_reopen(void){ return dev_rot.fd; }
+
+static int sim_rtc_read(struct rtc_time *rt){
+  secs_to_rt(sim.rtc_secs + (mono_ms() - sim.rtc_mono)/1000, rt);
+  return 0;
+}
+static int sim_rtc_set(const struct rtc_time *rt){
+  sim.rtc_secs = rt_to_secs(rt);
+  sim.rtc_mono = mono_ms();
+  return 0;
+}
+// 값이 계속 바뀌고 16번에 1번은 실패 (DHT ERR 화면도 지나가게)
+static int sim_dht_read(int *temp, int *humi){
+  unsigned n = sim.dht_n++;
+  if(n % 16 == 15) return -1;
+  *temp = 18 + (int)(n % 12);
+  *humi = 30 + (int)(n * 7 % 60);
+  return 0;
+}
+
+static uint32_t crc32_buf(const uint8_t *p, size_t n){
+  uint32_t c = 0xFFFFFFFFu;
+  while(n--){
+    c ^= *p++;
+    for(int k=0;k<8;k++) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1)));
+  }
+  return ~c;
+}
+
+// page 배치 fb -> PBM(P4, 1=켜진 픽셀, 한 줄 16바이트 MSB가 왼쪽)
+static int sim_write_pbm(const char *path, const uint8_t *src){
+  FILE *fp = fopen(path, "wb");
+  if(!fp) return -1;
+  fprintf(fp, "P4\n%d %d\n", OLED_W, OLED_H);
+  for(int y=0;y<OLED_H;y++){
+    uint8_t row[OLED_W/8] = {0};
+    for(int x=0;x<OLED_W;x++)
+      if((src[(y/8)*OLED_W + x] >> (y&7)) & 1) row[x/8] |= (uint8_t)(0x80u >> (x&7));
+    fwrite(row, 1, sizeof(row), fp);
+  }
+  return fclose(fp);
+}
+
+// 실제 패널과 같은 diff 규칙으로 "보낼 바이트"를 세고, 프레임은 PBM 또는 CRC로 남김
+static int sim_present(const Frame *f, int full){
+  int p0=0,p1=OLED_H/8-1,c0=0,c1=OLED_W-1;
+  uint64_t nbytes = FB_SZ;
+
+  memcpy(fb_last, sim.last, FB_SZ);
+  fb_last_valid = sim.last_valid;
+  if(sim.last_valid){
+    int ok = full ? fb_diff_span(f->fb, 0, OLED_H/8-1, 0, OLED_W-1, &p0,&p1,&c0,&c1)
+                  : fb_diff_span(f->fb, f->p0, f->p1, f->c0, f->c1, &p0,&p1,&c0,&c1);
+    if(!ok) return 0;
+    nbytes = (uint64_t)(p1-p0+1)*(c1-c0+1);
+  }
+  memcpy(sim.last, f->fb, FB_SZ);
+  sim.last_valid = 1;
+  stats.presents++;
+  stats.bytes += nbytes;
+
+  uint32_t idx = sim.nframe++;
+  if(opt_sim_out){
+    char path[512];
+    snprintf(path, sizeof(path), "%s/frame_%06u.pbm", opt_sim_out, idx);
+    if(sim_write_pbm(path, f->fb) < 0){ perror(path); return -1; }
+  } else {
+    printf("frame %06u crc32 %08x rect p%d-%d c%d-%d\n", idx, crc32_buf(f->fb, FB_SZ), p0, p1, c0, c1);
+    fflush(stdout);
+  }
+  return 0;
+}
+
+static const Backend be_sim = {
+  "sim", sim_init, sim_rot_reopen,
+  sim_rtc_read, sim_rtc_set, sim_dht_read, sim_present, 1,
+};
+
+static const Backend *be = &be_real;
+
+// -------- record / replay --------
+// 로그 = 헤더 + 8바이트 레코드. 시각은 기록 시작부터 ms, 회전은 이벤트 하나씩(합치기 전)
+#define LOG_MAGIC "EOL1"
+typedef struct {
+  char magic[4];
+  uint32_t reserved;
+  int64_t rtc_secs;        // 기록 시작 때 화면 벽시계 (리플레이 가짜 RTC 시작값)
+} LogHdr;
+typedef struct {
+  uint32_t t_ms;
+  uint8_t type;            // 'K' 'R' 'D'
+  int8_t a;                // R: delta, D: temp
+  uint8_t b, c;            // D: humi, ok
+} LogRec;
+
+static FILE *rec_fp;
+static int64_t rec_t0;
+static int rec_dht_last = -1;
+
+static int rec_open(const char *path, int64_t rtc_secs){
+  LogHdr h;
+  rec_fp = fopen(path, "wb");
+  if(!rec_fp){ perror(path); return -1; }
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, LOG_MAGIC, 4);
+  h.rtc_secs = rtc_secs;
+  fwrite(&h, sizeof(h), 1, rec_fp);
+  rec_t0 = mono_ms();
+  return 0;
+}
+static void rec_put(uint8_t type, int a, int b, int c){
+  if(!rec_fp) return;
+  LogRec r;
+  if(a > 127) a = 127;
+  if(a < -128) a = -128;
+  r.t_ms = (uint32_t)(mono_ms() - rec_t0);
+  r.type = type; r.a = (int8_t)a; r.b = (uint8_t)b; r.c = (uint8_t)c;
+  fwrite(&r, sizeof(r), 1, rec_fp);
+  fflush(rec_fp);
+}
+// 회전: 드라이버가 합쳐 보낸 delta는 int8을 넘을 수 있으니 ±127씩 나눠 기록 (합은 그대로)
+static void rec_rot(int delta){
+  if(!rec_fp) return;
+  do {
+    int d = delta > 127 ? 127 : delta < -127 ? -127 : delta;
+    rec_put('R', d, 0, 0);
+    delta -= d;
+  } while(delta);
+}
+// DHT는 값이 바뀔 때만
+static void rec_dht(int temp, int humi, int ok){
+  if(!rec_fp) return;
+  int key = ok ? (temp << 8 | humi) : -2;
+  if(key == rec_dht_last) return;
+  rec_dht_last = key;
+  rec_put('D', temp, humi, ok);
+}
+
+// closed-loop ack: 이벤트 #id가 화면까지 반영됐거나(=present) 그릴 게 없다고 판정되면 올림
+static _Atomic uint32_t acked_id;
+static int ack_efd = -1;
+static void ack_id(uint32_t id){
+  if(!id) return;
+  uint32_t cur = atomic_load(&acked_id);
+  while(cur < id && !atomic_compare_exchange_weak(&acked_id, &cur, id)) {}
+  if(ack_efd >= 0){ uint64_t one = 1; (void)!write(ack_efd, &one, sizeof(one)); }
+}
+
+static struct {
+  FILE *fp;
+  LogHdr hdr;
+  int temp, humi, ok;
+} rep;
+
+static void *replay_feeder(void *arg){
+  (void)arg;
+  LogRec r;
+  uint32_t id = 0;
+  int64_t t0 = mono_ns();
+  char msg[64];
+
+  while(fread(&r, sizeof(r), 1, rep.fp) == 1){
+    if(opt_speed > 0){
+      // 기록된 시각에 맞춰 (N배속이면 1/N)
+      int64_t due = t0 + (int64_t)r.t_ms * 1000000 / opt_speed;
+      struct timespec ts = { .tv_sec = due / 1000000000, .tv_nsec = due % 1000000000 };
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    id++;
+    int n;
+    long long now = (long long)mono_ns();
+    switch(r.type){
+      case 'K': n = snprintf(msg, sizeof(msg), "K #%u @%lld\n", id, now); break;
+      case 'R': n = snprintf(msg, sizeof(msg), "R %d 0 0 #%u @%lld\n", r.a, id, now); break;
+      case 'D': n = snprintf(msg, sizeof(msg), "D %d %u %u #%u @%lld\n", r.a, r.b, r.c, id, now); break;
+      default: id--; continue;
+    }
+    if(send(sim.sock[1], msg, (size_t)n, MSG_NOSIGNAL) < 0) break;
+
+    if(opt_speed == 0){
+      // 최대 속도: 앞 이벤트가 끝까지 처리된 뒤 다음 것 (큐잉 지연이 측정에 안 섞이게)
+      struct pollfd pf = { .fd = ack_efd, .events = POLLIN };
+      while(atomic_load(&acked_id) < id){
+        uint64_t x;
+        if(poll(&pf, 1, 1000) <= 0){ fprintf(stderr, "replay: ack timeout at #%u\n", id); break; }
+        (void)!read(ack_efd, &x, sizeof(x));
       }
     }
+  }
+  fclose(rep.fp);
+  shutdown(sim.sock[1], SHUT_WR);
+  return NULL;
+}
 
-    // DHT
-    dht_ok = (dht_read_now(&temp,&humi)==0);
+static int replay_init(void){
+  rep.fp = fopen(opt_replay, "rb");
+  if(!rep.fp){ perror(opt_replay); return -1; }
+  if(fread(&rep.hdr, sizeof(rep.hdr), 1, rep.fp) != 1 || memcmp(rep.hdr.magic, LOG_MAGIC, 4)){
+    fprintf(stderr, "replay: %s: not a record log\n", opt_replay);
+    return -1;
+  }
+  ack_efd = eventfd(0, EFD_CLOEXEC);
+  if(opt_real_display && dev_get(&dev_oled) < 0){ perror("open /dev/ssd1306"); return -1; }
+  return sim_start(replay_feeder, rep.hdr.rtc_secs);
+}
+// DHT 값은 로그의 'D' 이벤트로 들어옴 (rotary_drain에서 반영)
+static int replay_dht_read(int *temp, int *humi){
+  if(!rep.ok) return -1;
+  *temp = rep.temp; *humi = rep.humi;
+  return 0;
+}
+
+static Backend be_replay = {
+  "replay", replay_init, sim_rot_reopen,
+  sim_rtc_read, sim_rtc_set, replay_dht_read, sim_present, 1,
+};
 
-    if(toast_ticks>0){
-      toast_ticks--;
-      if(toast_ticks==0) toast[0]=0;
+// 단계별 지연. 각 LatSet은 한 thread만 추가함
+//  - 샘플(ns): 끝날 때 정렬해서 percentile. 데몬이 오래 돌아도 LAT_KEEP개까지만
+//  - log2 히스토그램: --latency-stats 파일용, 버킷 i = [2^(i-1), 2^i) us
+#define LAT_KEEP    (1u << 20)
+#define LAT_BUCKETS 24
+typedef struct {
+  const char *name;
+  uint32_t *v; size_t n, cap;
+  _Atomic uint32_t hist[LAT_BUCKETS];
+  _Atomic uint64_t count, sum_ns, max_ns;
+} LatSet;
+static LatSet lat_fsm    = { .name = "input->fsm" };     // 엣지 -> FSM (드라이버 디바운스/큐 + wakeup)
+static LatSet lat_render = { .name = "fsm->render" };    // 상태 publish -> 프레임 완성
+static LatSet lat_flush  = { .name = "render->panel" };  // 프레임 완성 -> 패널 전송 끝 (대기 + I2C)
+static LatSet lat_panel  = { .name = "input->panel" };   // 전체
+static LatSet *const lat_all[] = { &lat_fsm, &lat_render, &lat_flush, &lat_panel };
+
+static void lat_add(LatSet *l, int64_t ns){
+  if(ns < 0) return;
+  uint64_t us = (uint64_t)ns / 1000;
+  int b = 0;
+  while(us && b < LAT_BUCKETS-1){ us >>= 1; b++; }
+  atomic_fetch_add_explicit(&l->hist[b], 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&l->count, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&l->sum_ns, (uint64_t)ns, memory_order_relaxed);
+  if((uint64_t)ns > atomic_load_explicit(&l->max_ns, memory_order_relaxed))
+    atomic_store_explicit(&l->max_ns, (uint64_t)ns, memory_order_relaxed);
+
+  if(l->n >= LAT_KEEP) return;
+  if(l->n == l->cap){
+    size_t nc = l->cap ? l->cap*2 : 1024;
+    uint32_t *nv = realloc(l->v, nc*sizeof(*nv));
+    if(!nv) return;
+    l->v = nv; l->cap = nc;
+  }
+  l->v[l->n++] = ns > 0xFFFFFFFFll ? 0xFFFFFFFFu : (uint32_t)ns;
+}
+static int u32_cmp(const void *a, const void *b){
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+static void lat_report(LatSet *l){
+  if(!l->n) return;
+  qsort(l->v, l->n, sizeof(*l->v), u32_cmp);
+  #define PCT(q) (l->v[(size_t)((l->n - 1) * (q))] / 1e3)
+  fprintf(stderr, "%s: %-14s n=%zu p50 %.1f us  p90 %.1f us  p99 %.1f us  max %.1f us\n",
+          be->name, l->name, l->n, PCT(0.50), PCT(0.90), PCT(0.99), l->v[l->n-1] / 1e3);
+  #undef PCT
+}
+
+// 단계별 히스토그램을 텍스트로 (tmp에 쓰고 rename -> 읽는 쪽이 반쯤 쓴 파일을 안 봄)
+// 드라이버 쪽은 /sys/kernel/debug/rotary/rotaryN_latency, /sys/kernel/debug/ssd1306/{latency,bus}
+static void lat_write_stats(const char *path){
+  char tmp[256];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE *fp = fopen(tmp, "w");
+  if(!fp) return;
+  for(size_t i=0;i<sizeof(lat_all)/sizeof(lat_all[0]);i++){
+    LatSet *l = lat_all[i];
+    fprintf(fp, "# %s, us\n", l->name);
+    for(int b=0;b<LAT_BUCKETS;b++){
+      uint32_t c = atomic_load_explicit(&l->hist[b], memory_order_relaxed);
+      if(c) fprintf(fp, "< %8lu: %u\n", 1UL << b, c);
     }
+    fprintf(fp, "count: %llu\nmax: %llu\n\n",
+            (unsigned long long)atomic_load(&l->count),
+            (unsigned long long)atomic_load(&l->max_ns) / 1000);
+  }
+  if(fclose(fp) == 0) rename(tmp, path);
+  else unlink(tmp);
+}
 
-    // event
-    if(pr>0 && (pfd.revents & POLLIN)){
-      int is_key=0, delta=0;
-      if(read_rotary_event(fd_rot,&is_key,&delta)){
-        if(is_key){
-          if(!edit){
-            if(page==PAGE_CLOCK){
-              // enter edit: ALWAYS from good cache
-              ey   = rt_good.tm_year + 1900;
-              emo  = rt_good.tm_mon + 1;
-              ed   = rt_good.tm_mday;
-              eh   = rt_good.tm_hour;
-              emin = rt_good.tm_min;
-              es   = rt_good.tm_sec;
-
-              clamp_date(&ey,&emo,&ed);
-              clamp_hms(&eh,&emin,&es);
-
-              field = F_YEAR;
-              edit = 1;
-            } else {
-              page = PAGE_CLOCK;
-            }
-          } else {
-            if(field==F_EXIT){
-              // ALWAYS clamp before save
-              clamp_date(&ey,&emo,&ed);
-              clamp_hms(&eh,&emin,&es);
-
-              struct rtc_time nrt;
-              memset(&nrt,0,sizeof(nrt));
-              nrt.tm_year = ey - 1900;
-              nrt.tm_mon  = emo - 1;
-              nrt.tm_mday = ed;
-              nrt.tm_hour = eh;
-              nrt.tm_min  = emin;
-              nrt.tm_sec  = es;
-
-              if(rtc_set_with_retry(&nrt) == 0){
-                snprintf(toast,sizeof(toast),"SAVED");
-                toast_ticks = 10;
-                // 저장 직후 cache도 즉시 갱신(다음 화면에서 바로 반영)
-                rt_good = nrt;
-                have_good = 1;
-                clock_gettime(CLOCK_MONOTONIC, &mono_prev);
-                acc_ms = 0;
-              } else {
-                snprintf(toast,sizeof(toast),"SAVE FAIL");
-                toast_ticks = 15;
-              }
-
-              edit = 0;
-              field = F_YEAR;
-            } else {
-              field = (enum Field)((int)field + 1);
-              if(field > F_EXIT) field = F_EXIT;
-            }
-          }
-        } else if(delta != 0){
-          if(!edit){
-            page = (page==PAGE_CLOCK) ? PAGE_SENSOR : PAGE_CLOCK;
-          } else {
-            int step = (delta>0)? +1 : -1;
-            int reps = (delta>0)? delta : -delta;
-            if(reps<1) reps=1;
-            if(reps>5) reps=5;
-
-            for(int k=0;k<reps;k++){
-              switch(field){
-                case F_YEAR: ey += step; break;
-                case F_MON:  emo += step; break;
-                case F_DAY:  ed += step; break;
-                case F_HOUR: eh += step; break;
-                case F_MIN:  emin += step; break;
-                case F_SEC:  es += step; break;
-                case F_EXIT: break;
-              }
-              clamp_date(&ey,&emo,&ed);
-              clamp_hms(&eh,&emin,&es);
-            }
-          }
-        }
+// -------- metrics (Prometheus textfile) --------
+// node exporter textfile collector용. 드라이버 sysfs stats/ 디렉터리의 값(파일 하나 = 숫자 하나)과
+// 데몬 카운터를 모아 tmp에 쓰고 rename. dmesg는 안 봄
+static const struct { const char *glob, *drv; } metric_src[] = {
+  { "/sys/class/misc/ssd1306/stats",                 "ssd1306" },
+  { "/sys/class/dht11_class/dht11/stats",            "dht11"   },
+  { "/sys/class/rotary_device_class/rotary*/stats",  "rotary"  },
+  { "/sys/class/rtc/rtc*/device/stats",              "ds1302"  },
+};
+
+static int read_u64_file(const char *path, unsigned long long *v){
+  char buf[32];
+  int fd = open(path, O_RDONLY|O_CLOEXEC);
+  if(fd < 0) return -1;
+  ssize_t n = read(fd, buf, sizeof(buf)-1);
+  close(fd);
+  if(n <= 0) return -1;
+  buf[n] = 0;
+  char *end;
+  *v = strtoull(buf, &end, 10);
+  return end == buf ? -1 : 0;
+}
+
+// ".../rotary0/stats" -> "rotary0", ".../rtc0/device/stats" -> "rtc0"
+static void metric_dev_name(const char *dir, char *out, size_t sz){
+  char tmp[256];
+  snprintf(tmp, sizeof(tmp), "%s", dir);
+  char *p = strrchr(tmp, '/');
+  if(p) *p = 0;                                  // /stats
+  p = strrchr(tmp, '/');
+  if(p && !strcmp(p, "/device")){ *p = 0; p = strrchr(tmp, '/'); }
+  snprintf(out, sz, "%s", p ? p+1 : tmp);
+}
+
+static void metrics_drivers(FILE *fp){
+  for(size_t i=0;i<sizeof(metric_src)/sizeof(metric_src[0]);i++){
+    glob_t g;
+    if(glob(metric_src[i].glob, 0, NULL, &g) != 0) continue;
+    for(size_t k=0;k<g.gl_pathc;k++){
+      char dev[256];
+      metric_dev_name(g.gl_pathv[k], dev, sizeof(dev));
+      DIR *d = opendir(g.gl_pathv[k]);
+      if(!d) continue;
+      struct dirent *e;
+      while((e = readdir(d))){
+        char path[512];
+        unsigned long long v;
+        if(e->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", g.gl_pathv[k], e->d_name);
+        if(read_u64_file(path, &v) == 0)
+          fprintf(fp, "envoled_%s_%s{device=\"%s\"} %llu\n", metric_src[i].drv, e->d_name, dev, v);
       }
+      closedir(d);
     }
+    globfree(&g);
+  }
+}
 
-    // render (use rt_good always)
-    if(page==PAGE_CLOCK){
-      if(!edit) render_clock_view(&rt_good, (toast[0]?toast:NULL));
-      else      render_clock_edit(ey,emo,ed,eh,emin,es,field);
-    } else {
-      render_sensor_big(temp,humi,dht_ok);
+static void metrics_write(const char *path){
+  char tmp[256];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE *fp = fopen(tmp, "w");
+  if(!fp) return;
+
+  #define COUNTER(name, help, val) \
+    fprintf(fp, "# HELP envoled_" name " " help "\n# TYPE envoled_" name " counter\nenvoled_" name " %llu\n", \
+            (unsigned long long)(val))
+  COUNTER("wakeups_total", "Main loop wakeups.", stats.wakeups);
+  COUNTER("input_events_total", "Knob events processed.", stats.events);
+  COUNTER("frames_rendered_total", "Frames rendered.", stats.frames);
+  COUNTER("frames_presented_total", "Frames sent to the panel.", stats.presents);
+  COUNTER("panel_bytes_total", "Framebuffer bytes sent to the panel.", stats.bytes);
+  COUNTER("present_errors_total", "Failed panel writes.", stats.present_errors);
+  #undef COUNTER
+  fprintf(fp, "# HELP envoled_fsm_seconds_total Time spent in input handling.\n"
+              "# TYPE envoled_fsm_seconds_total counter\nenvoled_fsm_seconds_total %.6f\n",
+          stats.fsm_ns / 1e9);
+  fprintf(fp, "# HELP envoled_render_seconds_total Time spent rendering frames.\n"
+              "# TYPE envoled_render_seconds_total counter\nenvoled_render_seconds_total %.6f\n",
+          stats.render_ns / 1e9);
+  fprintf(fp, "# HELP envoled_render_seconds_max Slowest frame render.\n"
+              "# TYPE envoled_render_seconds_max gauge\nenvoled_render_seconds_max %.6f\n",
+          stats.render_ns_max / 1e9);
+
+  // 단계별 지연: log2 버킷을 그대로 histogram으로 (le = 버킷 윗값)
+  fprintf(fp, "# HELP envoled_input_latency_seconds Knob edge to each pipeline stage.\n"
+              "# TYPE envoled_input_latency_seconds histogram\n");
+  for(size_t i=0;i<sizeof(lat_all)/sizeof(lat_all[0]);i++){
+    LatSet *l = lat_all[i];
+    uint64_t cum = 0;
+    for(int b=0;b<LAT_BUCKETS;b++){   // 마지막 버킷 = 그 이상 전부 -> +Inf
+      char le[16];
+      cum += atomic_load_explicit(&l->hist[b], memory_order_relaxed);
+      if(b < LAT_BUCKETS-1) snprintf(le, sizeof(le), "%g", (double)(1UL << b) / 1e6);
+      else snprintf(le, sizeof(le), "+Inf");
+      fprintf(fp, "envoled_input_latency_seconds_bucket{stage=\"%s\",le=\"%s\"} %llu\n",
+              l->name, le, (unsigned long long)cum);
+    }
+    uint64_t cnt = cum;   // 버킷 합 = count (다른 thread가 더하는 중이어도 서로 맞게)
+    fprintf(fp, "envoled_input_latency_seconds_sum{stage=\"%s\"} %.6f\n", l->name, atomic_load(&l->sum_ns) / 1e9);
+    fprintf(fp, "envoled_input_latency_seconds_count{stage=\"%s\"} %llu\n", l->name, (unsigned long long)cnt);
+  }
+
+  metrics_drivers(fp);
+
+  if(fclose(fp) == 0) rename(tmp, path);
+  else unlink(tmp);
+}
+
+// sys 모드: RTC 한 번 읽어서 system clock과의 차이(벽시계 초) 기록
+static void rtc_check_drift(void){
+  struct rtc_time rt;
+  if(be->rtc_read(&rt) != 0 || !rtc_sane(&rt)){
+    fprintf(stderr, "env-oled: rtc resync: read failed\n");
+    return;
+  }
+  int64_t sys = sys_wall_secs(NULL);
+  long drift = (long)(rt_to_secs(&rt) - sys);
+  fprintf(stderr, "env-oled: rtc resync: rtc-sys drift %+ld s\n", drift);
+}
+
+// -------- clock state --------
+// 화면에 그릴 벽시계. rtc 모드: 매 tick RTC 읽기, 실패 시 마지막 good 값(초)을
+// monotonic에 anchor 해두고 그릴 때 한 번만 필드로 변환. sys 모드: CLOCK_REALTIME.
+static struct {
+  struct rtc_time now;
+  int have_good;
+  int64_t good_secs, good_mono;
+  int64_t next_resync;
+} clk;
+
+static void clock_anchor(const struct rtc_time *rt){
+  clk.now = *rt;
+  clk.have_good = 1;
+  clk.good_secs = rt_to_secs(rt);
+  clk.good_mono = mono_ms();
+}
+
+static void clock_update(void){
+  struct rtc_time rt;
+  int64_t now_ms = mono_ms();
+
+  if(opt_clock == CLK_SYS){
+    if(now_ms >= clk.next_resync){
+      rtc_check_drift();
+      clk.next_resync = now_ms + (int64_t)opt_resync_s*1000;
     }
+    sys_wall_secs(&clk.now);
+    clk.have_good = 1;
+  } else if(be->rtc_read(&rt)==0 && rtc_sane(&rt)){
+    clock_anchor(&rt);            // RTC로 동기화됐으니 anchor 갱신
+  } else if(!clk.have_good){
+    rtc_from_system(&rt);         // 첫 초기화만 system time 사용
+    clock_anchor(&rt);
+  } else {
+    // 마지막 good 값에서 계속 진행 (NTP로 덮어쓰지 않음), 몇 초가 밀렸든 변환 1번
+    secs_to_rt(clk.good_secs + (now_ms - clk.good_mono)/1000, &clk.now);
+  }
+}
+
+// -------- sensor history --------
+// DHT 값을 1분/1시간/1일 버킷(min/max/합)으로 미리 모아 두는 고정 크기 ring 파일 (mmap).
+// 슬롯 = (구간 시작 / 구간 길이) % 개수 라서 head가 없고, 슬롯의 start가 기대값과 다르면 빈 칸.
+// 지금 분은 RAM에서만 모으고 분이 바뀔 때 한 번 파일에 반영 -> SD 쓰기는 많아야 분당 1번
+#define HIST_MAGIC "EOH1"
+#define HIST_VERSION 2  // 2: n을 uint32로 (1일 버킷 = 86400 샘플)
+typedef struct {
+  uint32_t start;      // 구간 시작 (로컬 벽시계 분), 0 = 비어 있음
+  uint32_t n;          // 샘플 수 (1Hz)
+  int8_t   tmin, tmax;
+  uint8_t  hmin, hmax;
+  int32_t  tsum;
+  uint32_t hsum;
+} HBucket;
+
+enum { HT_MIN=0, HT_HOUR, HT_DAY, HT_N };
+static const struct { uint32_t span, cap; } htier[HT_N] = {
+  [HT_MIN]  = {    1, 1440 },   // 24시간
+  [HT_HOUR] = {   60,  720 },   // 30일
+  [HT_DAY]  = { 1440,  400 },   // 1년 남짓
+};
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  HBucket b_min[1440];
+  HBucket b_hour[720];
+  HBucket b_day[400];
+} HistFile;
+
+static struct {
+  HistFile *f;        // 파일 mmap (파일 없으면 anonymous -> 재시작하면 사라짐)
+  HBucket *tier[HT_N];
+  HBucket cur;        // 지금 분 (아직 파일에 안 씀)
+  uint32_t gen;       // 샘플/commit마다 증가 (그래프 캐시용)
+} hist;
+
+static void hb_add(HBucket *b, int t, int h){
+  if(!b->n){ b->tmin = b->tmax = (int8_t)t; b->hmin = b->hmax = (uint8_t)h; }
+  if(t < b->tmin) b->tmin = (int8_t)t;
+  if(t > b->tmax) b->tmax = (int8_t)t;
+  if(h < b->hmin) b->hmin = (uint8_t)h;
+  if(h > b->hmax) b->hmax = (uint8_t)h;
+  b->tsum += t; b->hsum += (uint32_t)h;
+  b->n++;
+}
+// 같은 구간이면 합치고, 슬롯에 옛 구간이 있으면 덮어씀
+static void hb_merge(HBucket *dst, uint32_t start, const HBucket *src){
+  if(dst->start != start || !dst->n){ *dst = *src; dst->start = start; return; }
+  if(src->tmin < dst->tmin) dst->tmin = src->tmin;
+  if(src->tmax > dst->tmax) dst->tmax = src->tmax;
+  if(src->hmin < dst->hmin) dst->hmin = src->hmin;
+  if(src->hmax > dst->hmax) dst->hmax = src->hmax;
+  dst->tsum += src->tsum; dst->hsum += src->hsum;
+  dst->n += src->n;
+}
+static HBucket *hist_slot(int t, uint32_t start){
+  return &hist.tier[t][(start / htier[t].span) % htier[t].cap];
+}
 
-    (void)fb_flush(fd_oled);
+static int hist_open(const char *path){
+  int created = 1;
+  if(path){
+    int fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC, 0644);
+    if(fd < 0){ perror(path); return -1; }
+    struct stat st;
+    if(fstat(fd, &st) == 0 && st.st_size == (off_t)sizeof(HistFile)) created = 0;
+    else if(ftruncate(fd, sizeof(HistFile)) < 0){ perror("ftruncate"); close(fd); return -1; }
+    hist.f = mmap(NULL, sizeof(HistFile), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+  } else {
+    hist.f = mmap(NULL, sizeof(HistFile), PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  }
+  if(hist.f == MAP_FAILED){ perror("mmap"); hist.f = NULL; return -1; }
+
+  if(created || memcmp(hist.f->magic, HIST_MAGIC, 4) || hist.f->version != HIST_VERSION){
+    memset(hist.f, 0, sizeof(HistFile));   // 새 파일 / 크기나 형식이 다름 -> 처음부터
+    memcpy(hist.f->magic, HIST_MAGIC, 4);
+    hist.f->version = HIST_VERSION;
   }
+  hist.tier[HT_MIN]  = hist.f->b_min;
+  hist.tier[HT_HOUR] = hist.f->b_hour;
+  hist.tier[HT_DAY]  = hist.f->b_day;
   return 0;
 }
 
+// 끝난 분을 1분/1시간/1일 버킷에 반영. 파일을 만지는 건 여기뿐
+static void hist_commit(void){
+  if(!hist.f || !hist.cur.n) return;
+  uint32_t m = hist.cur.start;
+  for(int t=0;t<HT_N;t++)
+    hb_merge(hist_slot(t, m - m % htier[t].span), m - m % htier[t].span, &hist.cur);
+  memset(&hist.cur, 0, sizeof(hist.cur));
+  hist.gen++;
+  if(opt_history) msync(hist.f, sizeof(HistFile), MS_ASYNC);
+}
+
+// 1초 tick마다. wall = 로컬 벽시계 초 (rt_to_secs)
+static void hist_sample(int64_t wall, int ok, int t, int h){
+  uint32_t m = (uint32_t)(wall / 60);
+  if(hist.cur.n && hist.cur.start != m) hist_commit();
+  if(!ok || !hist.f) return;
+  hist.cur.start = m;
+  hb_add(&hist.cur, t, h);
+  hist.gen++;
+}
+
+// 그래프 한 칸 = tier 버킷 1개. 지금 구간에는 아직 commit 안 된 분도 합쳐서 보여줌
+static int hist_get(int t, uint32_t start, HBucket *out){
+  const HBucket *b = hist_slot(t, start);
+  memset(out, 0, sizeof(*out));
+  if(b->start == start && b->n) *out = *b;
+  if(hist.cur.n && hist.cur.start - hist.cur.start % htier[t].span == start)
+    hb_merge(out, start, &hist.cur);
+  return out->n > 0;
+}
+
+// 그래프 구간: 몇 번째 tier의 버킷 몇 개
+enum { GS_HOUR=0, GS_DAY, GS_WEEK, GS_N };
+static const struct { const char *name; int tier, n; } gspan[GS_N] = {
+  [GS_HOUR] = { "1H",  HT_MIN,  60 },
+  [GS_DAY]  = { "24H", HT_HOUR, 24 },
+  [GS_WEEK] = { "7D",  HT_DAY,   7 },
+};
+
+// -------- view state --------
+// 화면에 보이는 것만 담음. 직전 값과 같으면 render/flush 생략
+typedef struct {
+  int page, edit, field;
+  int y, mo, d, h, mi, s;
+  int temp, humi, dht_ok;
+  char toast[32];
+  int gspan;                // PAGE_GRAPH
+  char glabel[24];
+  Spark gtemp, ghumi;
+} ViewState;
+
+// 시계 페이지 (보기/편집 같은 배치, 편집 필드는 highlight box)
+enum { WC_YEAR, WC_DASH1, WC_MON, WC_DASH2, WC_DAY,
+       WC_HH, WC_COL1, WC_MM, WC_COL2, WC_SS,
+       WC_FOOT, WC_EXIT, WC_SAVE, WC_N };
+static Widget w_clock[WC_N] = {
+  [WC_YEAR]  = LABEL( 0, 0, 24, 9, 1, ""),
+  [WC_DASH1] = LABEL(24, 0,  6, 9, 1, "-"),
+  [WC_MON]   = LABEL(30, 0, 12, 9, 1, ""),
+  [WC_DASH2] = LABEL(42, 0,  6, 9, 1, "-"),
+  [WC_DAY]   = LABEL(48, 0, 12, 9, 1, ""),
+  [WC_HH]    = LABEL( 0,16, 24,18, 2, ""),
+  [WC_COL1]  = LABEL(24,16, 12,18, 2, ":"),
+  [WC_MM]    = LABEL(36,16, 24,18, 2, ""),
+  [WC_COL2]  = LABEL(60,16, 12,18, 2, ":"),
+  [WC_SS]    = LABEL(72,16, 24,18, 2, ""),
+  [WC_FOOT]  = LABEL( 0,52,128,12, 1, ""),
+  [WC_EXIT]  = { .kind=W_LABEL, .scale=2, .hl=1, .x=0, .y=52, .w=48, .h=12, .text="EXIT" },
+  [WC_SAVE]  = LABEL(54,52, 74,12, 1, "K:SAVE"),
+};
+
+// 센서 페이지 (오른쪽 세로 막대 = 습도 gauge)
+enum { WS_HUMI_L, WS_HUMI, WS_TEMP_L, WS_TEMP, WS_GAUGE, WS_ERR, WS_ERR_HINT, WS_N };
+static Widget w_sensor[WS_N] = {
+  [WS_HUMI_L]  = LABEL(  0, 0, 24, 8, 1, "HUMI"),
+  [WS_HUMI]    = LABEL(  0,10, 72,21, 3, ""),
+  [WS_TEMP_L]  = LABEL(  0,38, 24, 8, 1, "TEMP"),
+  [WS_TEMP]    = LABEL(  0,48, 48,14, 2, ""),
+  [WS_GAUGE]   = GAUGE(112, 0, 16,64),
+  [WS_ERR]     = LABEL(  0, 0, 84,14, 2, "DHT ERR"),
+  [WS_ERR_HINT]= LABEL(  0,28, 90, 8, 1, "R:PAGE  K:CLOCK"),
+};
+
+// 그래프 페이지 (위: 온도, 아래: 습도 sparkline, 열마다 min~max)
+enum { WG_LABEL, WG_TEMP, WG_HUMI, WG_N };
+static Spark wg_temp, wg_humi;
+static Widget w_graph[WG_N] = {
+  [WG_LABEL] = LABEL(0, 0,128, 8, 1, ""),
+  [WG_TEMP]  = SPARK(0,10,128,26, &wg_temp),
+  [WG_HUMI]  = SPARK(0,38,128,26, &wg_humi),
+};
+
+static void ui_clock(const ViewState *v){
+  char b[24];
+  ui_show(w_clock, WC_N);
+
+  snprintf(b,sizeof(b),"%04d",v->y);  w_set_text(&w_clock[WC_YEAR], b);
+  snprintf(b,sizeof(b),"%02d",v->mo); w_set_text(&w_clock[WC_MON], b);
+  snprintf(b,sizeof(b),"%02d",v->d);  w_set_text(&w_clock[WC_DAY], b);
+  snprintf(b,sizeof(b),"%02d",v->h);  w_set_text(&w_clock[WC_HH], b);
+  snprintf(b,sizeof(b),"%02d",v->mi); w_set_text(&w_clock[WC_MM], b);
+  snprintf(b,sizeof(b),"%02d",v->s);  w_set_text(&w_clock[WC_SS], b);
+
+  static const int fw[] = { [F_YEAR]=WC_YEAR, [F_MON]=WC_MON, [F_DAY]=WC_DAY,
+                            [F_HOUR]=WC_HH, [F_MIN]=WC_MM, [F_SEC]=WC_SS };
+  for(int f=F_YEAR; f<=F_SEC; f++)
+    w_set_hl(&w_clock[fw[f]], v->edit && v->field==f);
+
+  int ex = v->edit && v->field==F_EXIT;
+  w_set_visible(&w_clock[WC_FOOT], !ex);
+  w_set_visible(&w_clock[WC_EXIT], ex);
+  w_set_visible(&w_clock[WC_SAVE], ex);
+  w_set_text(&w_clock[WC_FOOT], v->edit ? "K:NEXT  R:CHANGE" :
+                                (v->toast[0] ? v->toast : "K:EDIT  R:PAGE"));
+}
+
+static void ui_sensor(const ViewState *v){
+  char b[24];
+  ui_show(w_sensor, WS_N);
 
+  for(int i=WS_HUMI_L; i<=WS_GAUGE; i++) w_set_visible(&w_sensor[i], v->dht_ok);
+  w_set_visible(&w_sensor[WS_ERR], !v->dht_ok);
+  w_set_visible(&w_sensor[WS_ERR_HINT], !v->dht_ok);
+  if(!v->dht_ok) return;
+
+  snprintf(b,sizeof(b),"%02d%%",v->humi); w_set_text(&w_sensor[WS_HUMI], b);
+  snprintf(b,sizeof(b),"%02dC",v->temp);  w_set_text(&w_sensor[WS_TEMP], b);
+  w_set_value(&w_sensor[WS_GAUGE], v->humi);
+}
+
+static void ui_graph(const ViewState *v){
+  ui_show(w_graph, WG_N);
+  w_set_text(&w_graph[WG_LABEL], v->glabel);
+  w_set_spark(&w_graph[WG_TEMP], &v->gtemp);
+  w_set_spark(&w_graph[WG_HUMI], &v->ghumi);
+}
+
+static void render_view(const ViewState *v){
+  if(v->page==PAGE_CLOCK)       ui_clock(v);
+  else if(v->page==PAGE_SENSOR) ui_sensor(v);
+  else                          ui_graph(v);
+  ui_render();
+}
+
+// 초 경계 정렬 1Hz tick (CLOCK_REALTIME 절대시각, 시계가 점프하면 read가 ECANCELED)
+static int tick_arm(int tfd){
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  its.it_interval.tv_sec = 1;
+  its.it_value.tv_sec = now.tv_sec + 1;
+  return timerfd_settime(tfd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &its, NULL);
+}
+
+// -------- threads --------
+// input/FSM(main, epoll) -> ViewState -> render thread -> Frame -> display thread(I2C)
+// 단계 사이는 SPSC triple buffer: writer는 자기 back 슬롯에 쓰고 publish에서 middle과 맞바꾸고,
+// reader는 새 middle이 있으면 자기 front와 맞바꿈. 락 없음, reader는 항상 최신 것만 가져감
+#define TB_NEW 4u
+typedef struct {
+  _Atomic unsigned mid;   // middle 슬롯 index | TB_NEW
+  unsigned back;          // writer 전용
+  unsigned front;         // reader 전용
+  int efd;                // reader 깨우기
+} TriBuf;
+
+static int tb_init(TriBuf *t){
+  atomic_init(&t->mid, 1u);
+  t->back = 0;
+  t->front = 2;
+  t->efd = eventfd(0, EFD_CLOEXEC);
+  return t->efd;
+}
+static void tb_kick(TriBuf *t){
+  uint64_t one = 1;
+  (void)!write(t->efd, &one, sizeof(one));
+}
+
+static void tb_publish(TriBuf *t){
+  t->back = atomic_exchange_explicit(&t->mid, t->back | TB_NEW, memory_order_acq_rel) & 3u;
+  tb_kick(t);
+}
+static int tb_take(TriBuf *t){
+  if(!(atomic_load_explicit(&t->mid, memory_order_acquire) & TB_NEW)) return 0;
+  t->front = atomic_exchange_explicit(&t->mid, t->front, memory_order_acq_rel) & 3u;
+  return 1;
+}
+static void tb_wait(TriBuf *t, int timeout_ms){
+  struct pollfd p = { .fd = t->efd, .events = POLLIN };
+  uint64_t n;
+  if(poll(&p, 1, timeout_ms) > 0) (void)!read(t->efd, &n, sizeof(n));
+}
+
+// 이 상태/프레임에 반영된 입력: 가장 큰 리플레이 id, 가장 이른 발생 시각
+typedef struct {
+  ViewState v;
+  uint32_t in_id;
+  int64_t in_ns;
+  int64_t pub_ns;   // FSM이 넘긴 시각
+} ViewSlot;
+
+static ViewSlot vs_slot[3];
+static TriBuf tb_view;
+static Frame frame_slot[3];
+static TriBuf tb_frame;
+
+// 종료: 앞 단계가 마지막 것을 publish 한 뒤에 세움 -> 뒤 단계는 남은 것까지 처리하고 나감
+static atomic_int stop_render, stop_disp;
+
+// 위젯/fb/damage는 이 thread만 만짐
+static void *render_thread(void *arg){
+  uint32_t seq = 0;
+  (void)arg;
+  for(;;){
+    int stop = atomic_load(&stop_render);
+    if(!tb_take(&tb_view)){
+      if(stop) break;
+      tb_wait(&tb_view, -1);
+      continue;
+    }
+    int64_t t0 = mono_ns();
+    const ViewSlot *vs = &vs_slot[tb_view.front];
+    render_view(&vs->v);
+    if(dmg_p1 < 0){   // 바뀐 위젯 없음
+      ack_id(vs->in_id);
+      continue;
+    }
+
+    Frame *f = &frame_slot[tb_frame.back];
+    memcpy(f->fb, fb, FB_SZ);
+    f->seq = ++seq;
+    f->p0 = dmg_p0; f->p1 = dmg_p1; f->c0 = dmg_c0; f->c1 = dmg_c1;
+    f->in_id = vs->in_id;
+    f->in_ns = vs->in_ns;
+    f->ready_ns = mono_ns();
+    dmg_reset();
+    tb_publish(&tb_frame);
+    if(vs->in_ns) lat_add(&lat_render, f->ready_ns - vs->pub_ns);
+
+    uint64_t dt = (uint64_t)(mono_ns() - t0);
+    stats.frames++;
+    stats.render_ns += dt;
+    if(dt > stats.render_ns_max) stats.render_ns_max = dt;
+  }
+  atomic_store(&stop_disp, 1);
+  tb_kick(&tb_frame);
+  return NULL;
+}
+
+// I2C가 느리거나 막혀도 input/render는 계속 돌고, 여기서는 항상 제일 새 프레임만 보냄
+static void *display_thread(void *arg){
+  uint32_t last_seq = 0;
+  int retry = 0;
+  (void)arg;
+  for(;;){
+    int stop = atomic_load(&stop_disp);
+    if(!tb_take(&tb_frame)){
+      if(stop) break;
+      tb_wait(&tb_frame, retry ? 500 : -1);
+      if(!retry) continue;
+      tb_take(&tb_frame);   // 재시도: 그 사이 새 프레임이 왔으면 그걸로
+    }
+    const Frame *f = &frame_slot[tb_frame.front];
+    // 건너뛴 프레임(또는 재시도)의 damage는 모름 -> 전체에서 diff
+    int full = (f->seq != last_seq + 1);
+    retry = (be->present(f, full) < 0);
+    if(!retry && f->in_ns && f->seq != last_seq){
+      int64_t now = mono_ns();
+      lat_add(&lat_flush, now - f->ready_ns);
+      lat_add(&lat_panel, now - f->in_ns);   // 입력 -> 패널 반영
+    }
+    ack_id(f->in_id);
+    last_seq = f->seq;
+  }
+  return NULL;
+}
+
+// -------- FSM (input thread) --------
+static struct {
+  enum Page page;
+  int edit;
+  enum Field field;
+  int ey, emo, ed, eh, emin, es;   // edit buffer
+  int temp, humi, dht_ok;          // sensor
+  char toast[32];                  // toast (monotonic ms 기준 만료)
+  int64_t toast_until;
+  int gspan;                       // 그래프 구간 (GS_*)
+} fsm = { .page = PAGE_CLOCK, .field = F_YEAR, .ey = 2025, .emo = 1, .ed = 1 };
+
+static void fsm_toast(const char *msg, int ms){
+  snprintf(fsm.toast, sizeof(fsm.toast), "%s", msg);
+  fsm.toast_until = mono_ms() + ms;
+}
+
+static void fsm_key(void){
+  if(!fsm.edit){
+    if(fsm.page==PAGE_CLOCK){
+      // enter edit: ALWAYS from good cache (tick 사이라도 최신으로)
+      clock_update();
+      fsm.ey   = clk.now.tm_year + 1900;
+      fsm.emo  = clk.now.tm_mon + 1;
+      fsm.ed   = clk.now.tm_mday;
+      fsm.eh   = clk.now.tm_hour;
+      fsm.emin = clk.now.tm_min;
+      fsm.es   = clk.now.tm_sec;
+
+      clamp_date(&fsm.ey,&fsm.emo,&fsm.ed);
+      clamp_hms(&fsm.eh,&fsm.emin,&fsm.es);
+
+      fsm.field = F_YEAR;
+      fsm.edit = 1;
+    } else if(fsm.page==PAGE_GRAPH){
+      fsm.gspan = (fsm.gspan + 1) % GS_N;   // 그래프: 키 = 구간 바꾸기
+    } else {
+      fsm.page = PAGE_CLOCK;
+    }
+    return;
+  }
+
+  if(fsm.field != F_EXIT){
+    fsm.field = (enum Field)((int)fsm.field + 1);
+    return;
+  }
+
+  // ALWAYS clamp before save
+  clamp_date(&fsm.ey,&fsm.emo,&fsm.ed);
+  clamp_hms(&fsm.eh,&fsm.emin,&fsm.es);
+
+  struct rtc_time nrt;
+  memset(&nrt,0,sizeof(nrt));
+  nrt.tm_year = fsm.ey - 1900;
+  nrt.tm_mon  = fsm.emo - 1;
+  nrt.tm_mday = fsm.ed;
+  nrt.tm_hour = fsm.eh;
+  nrt.tm_min  = fsm.emin;
+  nrt.tm_sec  = fsm.es;
+
+  int rtc_ok = (be->rtc_set(&nrt) == 0);
+  // sys 모드는 화면이 system clock 기준이라 양쪽 다 써야 바로 반영됨
+  int sys_ok = (opt_clock != CLK_SYS) || (sys_set_wall(&nrt) == 0);
+  if(opt_clock == CLK_SYS)
+    clk.next_resync = mono_ms() + (int64_t)opt_resync_s*1000;
+
+  if(rtc_ok && !sys_ok){
+    fsm_toast("SYS FAIL", 3000);
+  } else if(rtc_ok){
+    fsm_toast("SAVED", 2000);
+    // 저장 직후 cache도 즉시 갱신(다음 화면에서 바로 반영)
+    clock_anchor(&nrt);
+  } else {
+    fsm_toast("SAVE FAIL", 3000);
+  }
+
+  fsm.edit = 0;
+  fsm.field = F_YEAR;
+}
+
+// delta: 한 번에 읽어 온 회전을 합친 값
+static void fsm_rotate(int delta){
+  if(delta == 0) return;
+  if(!fsm.edit){
+    // 보기 모드: 합친 회전 1번 = 페이지 1장 (방향대로 돌아감)
+    fsm.page = (enum Page)((fsm.page + (delta>0 ? 1 : PAGE_N-1)) % PAGE_N);
+    return;
+  }
+  // 드라이버가 빠른 회전을 합치거나 가속해서 delta가 클 수 있음 -> 그대로 반영
+  int step = (delta>0)? +1 : -1;
+  int reps = (delta>0)? delta : -delta;
+  if(reps>100) reps=100;
+
+  for(int k=0;k<reps;k++){
+    switch(fsm.field){
+      case F_YEAR: fsm.ey += step; break;
+      case F_MON:  fsm.emo += step; break;
+      case F_DAY:  fsm.ed += step; break;
+      case F_HOUR: fsm.eh += step; break;
+      case F_MIN:  fsm.emin += step; break;
+      case F_SEC:  fsm.es += step; break;
+      case F_EXIT: break;
+    }
+    clamp_date(&fsm.ey,&fsm.emo,&fsm.ed);
+    clamp_hms(&fsm.eh,&fsm.emin,&fsm.es);
+  }
+}
+
+// 깨어날 때마다 쌓인 이벤트를 EAGAIN까지 전부 읽음. 키 사이의 회전은 합쳐서 FSM에 한 번만
+static int g_running = 1;
+static int64_t stats_next_write;   // --latency-stats / --metrics 다음 갱신 (mono ms)
+// 마지막 publish 이후 처리한 입력 (다음 ViewSlot에 실림)
+static uint32_t pend_id;
+static int64_t pend_ns;
+
+static void rotary_drain(void){
+  int acc = 0;
+  int64_t t0 = mono_ns();
+  for(int guard=0; guard<1024; guard++){
+    InEv ev;
+    int r = read_rotary_event(dev_rot.fd,&ev);
+    if(r == -2){
+      if(be->eof_quits) g_running = 0;   // 스크립트/로그 끝
+      break;
+    }
+    if(r < 0){
+      if(errno == EINTR) continue;
+      if(errno != EAGAIN) dev_drop(&dev_rot);
+      break;
+    }
+    if(r == 0) continue;
+    stats.events++;
+    if(ev.id > pend_id) pend_id = ev.id;
+    if(ev.stamp_ns){
+      lat_add(&lat_fsm, mono_ns() - ev.stamp_ns);   // 입력 -> FSM
+      if(!pend_ns || ev.stamp_ns < pend_ns) pend_ns = ev.stamp_ns;
+    }
+    if(ev.kind == EVK_KEY){
+      rec_put('K', 0, 0, 0);
+      fsm_rotate(acc);   // 키 앞의 회전은 키보다 먼저 반영 (순서 유지)
+      acc = 0;
+      fsm_key();
+    } else if(ev.kind == EVK_ROT){
+      rec_rot(ev.delta);
+      acc += ev.delta;
+    } else if(ev.kind == EVK_DHT){
+      rep.temp = ev.temp; rep.humi = ev.humi; rep.ok = ev.ok;
+      fsm.dht_ok = (be->dht_read(&fsm.temp,&fsm.humi)==0);
+      rec_dht(fsm.temp, fsm.humi, fsm.dht_ok);
+    }
+  }
+  fsm_rotate(acc);
+  stats.fsm_ns += (uint64_t)(mono_ns() - t0);
+}
+
+// 버킷 n개(오래된 것부터)를 픽셀 열에 펼침. 세로는 보이는 구간의 min~max로 자동 범위
+static void spark_build(Spark *sp, const int *lo, const int *hi, const uint8_t *ok, int n, int h,
+                        int *vmin, int *vmax){
+  *vmin = 1000; *vmax = -1000;
+  for(int i=0;i<n;i++) if(ok[i]){
+    if(lo[i] < *vmin) *vmin = lo[i];
+    if(hi[i] > *vmax) *vmax = hi[i];
+  }
+  int range = *vmax - *vmin;
+  for(int x=0;x<SPARK_W;x++){
+    int i = x * n / SPARK_W;
+    int gap = (SPARK_W / n >= 3) && ((x+1) * n / SPARK_W != i);   // 넓은 칸 사이 1px
+    if(!ok[i] || gap){ sp->lo[x] = 1; sp->hi[x] = 0; continue; }
+    if(range == 0){ sp->lo[x] = sp->hi[x] = (uint8_t)(h/2); continue; }
+    sp->lo[x] = (uint8_t)((h-1) - (hi[i] - *vmin) * (h-1) / range);
+    sp->hi[x] = (uint8_t)((h-1) - (lo[i] - *vmin) * (h-1) / range);
+  }
+}
+
+// 샘플이 들어오거나 구간이 바뀔 때만 다시 계산 (버킷 최대 60개 조회)
+static void graph_view(ViewState *v){
+  static uint32_t c_gen = ~0u;
+  static int c_span = -1;
+  static int64_t c_now = -1;
+  static char c_label[24];
+  static Spark c_t, c_h;
+
+  int gs = fsm.gspan;
+  int tier = gspan[gs].tier, n = gspan[gs].n;
+  uint32_t span = htier[tier].span;
+  uint32_t now_m = (uint32_t)(rt_to_secs(&clk.now) / 60);
+  uint32_t last = now_m - now_m % span;
+
+  if(hist.gen != c_gen || gs != c_span || last != c_now){
+    int tlo[60], thi[60], hlo[60], hhi[60];
+    uint8_t ok[60];
+    for(int i=0;i<n;i++){
+      HBucket b;
+      ok[i] = (uint8_t)hist_get(tier, last - (uint32_t)(n-1-i) * span, &b);
+      tlo[i] = b.tmin; thi[i] = b.tmax; hlo[i] = b.hmin; hhi[i] = b.hmax;
+    }
+    int t0, t1, h0, h1;
+    spark_build(&c_t, tlo, thi, ok, n, w_graph[WG_TEMP].h, &t0, &t1);
+    spark_build(&c_h, hlo, hhi, ok, n, w_graph[WG_HUMI].h, &h0, &h1);
+    if(t0 > t1) snprintf(c_label, sizeof(c_label), "%s NO DATA", gspan[gs].name);
+    else snprintf(c_label, sizeof(c_label), "%s T%d-%dC H%d-%d%%", gspan[gs].name, t0, t1, h0, h1);
+    c_gen = hist.gen; c_span = gs; c_now = last;
+  }
+  v->gspan = gs;
+  memcpy(v->glabel, c_label, sizeof(v->glabel));
+  v->gtemp = c_t;
+  v->ghumi = c_h;
+}
+
+// 지금 보이는 페이지에 필요한 값만 채움 (직전 화면과 비교용)
+static void fsm_view(ViewState *v){
+  memset(v, 0, sizeof(*v));
+  v->page = fsm.page;
+  v->edit = fsm.edit;
+  if(fsm.page==PAGE_CLOCK && fsm.edit){
+    v->field = fsm.field;
+    v->y = fsm.ey; v->mo = fsm.emo; v->d = fsm.ed; v->h = fsm.eh; v->mi = fsm.emin; v->s = fsm.es;
+  } else if(fsm.page==PAGE_CLOCK){
+    v->y  = clk.now.tm_year + 1900; v->mo = clk.now.tm_mon + 1; v->d = clk.now.tm_mday;
+    v->h  = clk.now.tm_hour; v->mi = clk.now.tm_min; v->s = clk.now.tm_sec;
+    memcpy(v->toast, fsm.toast, sizeof(v->toast));
+  } else if(fsm.page==PAGE_SENSOR){
+    v->temp = fsm.temp; v->humi = fsm.humi; v->dht_ok = fsm.dht_ok;
+  } else {
+    graph_view(v);
+  }
+}
+
+int main(int argc, char **argv){
+  if(parse_args(argc, argv) < 0) return 2;
+  if(opt_sim) be = &be_sim;
+  if(opt_replay){
+    if(opt_real_display) be_replay.present = fb_present;
+    be = &be_replay;
+  }
+
+  font_init();
+
+  // TZ 규칙은 시작 시 한 번만 로드 (이후 localtime_r이 매번 다시 읽지 않게)
+  tzset();
+
+  // sys 모드: RTC는 시작 + 주기적 resync 때만 (정상 루프에서 GPIO bit-bang 없음)
+  if(opt_clock == CLK_SYS){
+    rtc_check_drift();
+    clk.next_resync = mono_ms() + (int64_t)opt_resync_s*1000;
+  }
+
+  // SIGTERM(systemd stop)/Ctrl-C도 epoll로 받아서 아래 종료 경로(통계/metrics/history flush)를 탐.
+  // thread 만들기 전에 막아야 다른 thread로 배달되지 않음
+  sigset_t sigs;
+  sigemptyset(&sigs);
+  sigaddset(&sigs, SIGINT);
+  sigaddset(&sigs, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+
+  g_ep = epoll_create1(EPOLL_CLOEXEC);
+  int tfd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK|TFD_CLOEXEC);
+  int sfd = signalfd(-1, &sigs, SFD_NONBLOCK|SFD_CLOEXEC);
+  if(g_ep<0 || tfd<0 || sfd<0){ perror("epoll/timerfd/signalfd"); return 1; }
+  if(tick_arm(tfd)<0 || ep_add(g_ep, tfd, SRC_TICK)<0 || ep_add(g_ep, sfd, SRC_SIG)<0){
+    perror("epoll setup"); return 1;
+  }
+
+  if(be->init() < 0) return 1;
+  if(hist_open(opt_history) < 0 && hist_open(NULL) < 0) return 1;
+
+  clock_update();
+  // 새 샘플 나올 때 깨워주는 dht11 드라이버면 이벤트로(dev_dht.evented), 아니면 tick마다 읽기
+  fsm.dht_ok = (be->dht_read(&fsm.temp,&fsm.humi)==0);
+  if(opt_record){
+    if(rec_open(opt_record, rt_to_secs(&clk.now)) < 0) return 1;
+    rec_dht(fsm.temp, fsm.humi, fsm.dht_ok);
+  }
+
+  if(tb_init(&tb_view)<0 || tb_init(&tb_frame)<0){ perror("eventfd"); return 1; }
+  pthread_t th_render, th_disp;
+  if(pthread_create(&th_render, NULL, render_thread, NULL) ||
+     pthread_create(&th_disp, NULL, display_thread, NULL)){
+    fprintf(stderr, "pthread_create failed\n");
+    return 1;
+  }
+  pthread_setname_np(th_render, "oled-render");
+  pthread_setname_np(th_disp, "oled-disp");
+
+  ViewState last;
+  int have_last = 0;
+
+  while(g_running){
+    struct epoll_event evs[4];
+    int n = epoll_wait(g_ep, evs, 4, -1);
+    if(n < 0){
+      if(errno == EINTR) continue;
+      perror("epoll_wait");
+      break;
+    }
+    stats.wakeups++;
+
+    for(int i=0;i<n;i++){
+      switch(evs[i].data.u32){
+      case SRC_TICK: {
+        uint64_t exp;
+        if(read(tfd, &exp, sizeof(exp)) < 0 && errno == ECANCELED)
+          tick_arm(tfd);   // 시계가 바뀜 -> 새 초 경계로 다시 정렬
+        clock_update();
+        if(!dev_dht.evented){
+          fsm.dht_ok = (be->dht_read(&fsm.temp,&fsm.humi)==0);
+          rec_dht(fsm.temp, fsm.humi, fsm.dht_ok);
+        }
+        if(dev_rot.fd < 0)
+          be->rot_reopen();   // 에러로 닫혔으면 다시 열고 epoll 재등록
+        if(fsm.toast[0] && mono_ms() >= fsm.toast_until) fsm.toast[0]=0;
+        hist_sample(rt_to_secs(&clk.now), fsm.dht_ok, fsm.temp, fsm.humi);
+        if((opt_lat_stats || opt_metrics) && mono_ms() >= stats_next_write){
+          if(opt_lat_stats) lat_write_stats(opt_lat_stats);
+          if(opt_metrics) metrics_write(opt_metrics);
+          stats_next_write = mono_ms() + 10000;
+        }
+        break;
+      }
+      case SRC_DHT:
+        fsm.dht_ok = (be->dht_read(&fsm.temp,&fsm.humi)==0);
+        rec_dht(fsm.temp, fsm.humi, fsm.dht_ok);
+        break;
+      case SRC_ROT:
+        rotary_drain();
+        break;
+      case SRC_SIG: {
+        struct signalfd_siginfo si;
+        if(read(sfd, &si, sizeof(si)) == sizeof(si)) g_running = 0;
+        break;
+      }
+      }
+    }
+
+    // 이번 wakeup에서 처리한 것 전부 반영해서 한 번만 넘김
+    ViewState v;
+    fsm_view(&v);
+
+    if(have_last && memcmp(&v, &last, sizeof(v))==0){
+      ack_id(pend_id);   // 화면에 영향 없는 입력
+      pend_id = 0; pend_ns = 0;
+      continue;
+    }
+    // 그리기/I2C 전송은 다른 thread에서. 여기서는 상태만 넘기고 바로 다음 입력 대기
+    vs_slot[tb_view.back] = (ViewSlot){ v, pend_id, pend_ns, mono_ns() };
+    pend_id = 0; pend_ns = 0;
+    tb_publish(&tb_view);
+    last = v;
+    have_last = 1;
+  }
+
+  // 남은 상태/프레임까지 그리고 내보낸 뒤 종료
+  atomic_store(&stop_render, 1);
+  tb_kick(&tb_view);
+  pthread_join(th_render, NULL);
+  pthread_join(th_disp, NULL);
+
+  fprintf(stderr, "%s: %llu input events in %llu wakeups, fsm %.2f us/event\n", be->name,
+          (unsigned long long)stats.events, (unsigned long long)stats.wakeups,
+          stats.events ? stats.fsm_ns / 1e3 / stats.events : 0.0);
+  fprintf(stderr, "%s: %llu frames rendered, render avg %.2f us max %.2f us\n", be->name,
+          (unsigned long long)stats.frames,
+          stats.frames ? stats.render_ns / 1e3 / stats.frames : 0.0, stats.render_ns_max / 1e3);
+  fprintf(stderr, "%s: %llu frames presented, %llu bytes to panel\n", be->name,
+          (unsigned long long)stats.presents, (unsigned long long)stats.bytes);
+  for(size_t i=0;i<sizeof(lat_all)/sizeof(lat_all[0]);i++)
+    lat_report(lat_all[i]);
+  if(opt_lat_stats) lat_write_stats(opt_lat_stats);
+  if(opt_metrics) metrics_write(opt_metrics);
+  if(rec_fp) fclose(rec_fp);
+  hist_commit();   // 끝나지 않은 분도 남김 (같은 분에 다시 시작하면 합쳐짐)
+  return 0;
+}